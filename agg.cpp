@@ -5,30 +5,62 @@
         Goal: From a CSV date,category,amount, compute totals per category and overall.
 
     CLI: 
-        agg input.csv [--sorted] [--top K].
+        agg input.csv... [--sorted] [--top K] [--by name|total] [--threads N] [--float]
+        [--state file.bin] [--key COLS] [--value COL] [--agg sum,count,min,max,mean]
+        [--stats].
+        COLS are column numbers or day/month of the date in column 0, e.g.
+        --key month,1 groups by month and category.
+        "-" reads stdin; pipes and stdin are streamed, regular files mapped.
 
     Output: 
-        table category,total (amount is decimal; use long double).
+        table category:total (amount is decimal; summed exactly in fixed
+        point, --float sums in long double), or key:agg,agg,... with --agg.
 */
 
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <deque>
+#include <fcntl.h>
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
+#include <memory>
 #include <numeric>
 #include <regex>
 #include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+
+#include "stats.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 struct Option {
     Option() :
         sorted(false),
-        k(-1)
+        k(-1),
+        threads(1),
+        useFloat(false),
+        key("1"),
+        value(2),
+        aggs("sum"),
+        stats(false)
     {
     };
 
@@ -36,14 +68,20 @@ struct Option {
     {
         if (argc > 1)
         {
-            filename = argv[1];
-
             int c;
             while (1)
             {
                 static struct option longOpt[] = {
                     { "sorted", no_argument, 0, 's' },
                     { "top", required_argument, 0, 't'},
+                    { "threads", required_argument, 0, 'n'},
+                    { "float", no_argument, 0, 'f'},
+                    { "by", required_argument, 0, 'b'},
+                    { "state", required_argument, 0, 'S'},
+                    { "key", required_argument, 0, 'k'},
+                    { "value", required_argument, 0, 'v'},
+                    { "agg", required_argument, 0, 'a'},
+                    { "stats", no_argument, 0, 'x'},
                     { 0, 0, 0, 0 }
                 };
 
@@ -60,22 +98,227 @@ struct Option {
                     break;
                 case 't':
                     k = std::atoi(optarg);
+                    break;
+                case 'n':
+                    threads = std::atoi(optarg);
+                    if (threads <= 0)
+                    {
+                        threads = static_cast<int>(std::thread::hardware_concurrency());
+                    }
+                    break;
+                case 'f':
+                    useFloat = true;
+                    break;
+                case 'b':
+                    by = optarg;
+                    break;
+                case 'S':
+                    state = optarg;
+                    break;
+                case 'k':
+                    key = optarg;
+                    break;
+                case 'v':
+                    value = std::atoi(optarg);
+                    break;
+                case 'a':
+                    aggs = optarg;
+                    break;
+                case 'x':
+                    stats = true;
                 }
             }
+
+            // everything left is an input, "-" is stdin
+            for (int i = optind; i < argc; ++i)
+            {
+                filenames.push_back(argv[i]);
+            }
         }
     }
 
     void print()
     {
         std::cout << "Options   " << std::endl;
-        std::cout << "filename : " << filename << std::endl;
+        std::cout << "filename :";
+        for (auto &f : filenames)
+        {
+            std::cout << " " << f;
+        }
+        std::cout << std::endl;
         std::cout << "k        : " << k << std::endl;
         std::cout << "sorted   : " << (sorted ? "true" : "false") << std::endl;
+        std::cout << "threads  : " << threads << std::endl;
+        std::cout << "float    : " << (useFloat ? "true" : "false") << std::endl;
+        std::cout << "by       : " << by << std::endl;
+        std::cout << "state    : " << state << std::endl;
+        std::cout << "key      : " << key << std::endl;
+        std::cout << "value    : " << value << std::endl;
+        std::cout << "agg      : " << aggs << std::endl;
+        std::cout << "stats    : " << (stats ? "true" : "false") << std::endl;
     }
 
     bool sorted;
     int k;
-    std::string filename;
+    int threads;
+    bool useFloat;
+    std::string by;         // "name" or "total", empty keeps first-seen order
+    std::string state;      // incremental snapshot file
+    std::string key;        // group-by columns, see CSV::parseKey()
+    int value;              // amount column
+    std::string aggs;       // measures, see CSV::parseMeasures()
+    bool stats;             // phase timings as JSON on stderr
+    std::vector<std::string> filenames;
+};
+
+/* read-only memory map of a whole file */
+class MappedFile
+{
+public :
+    MappedFile() :
+        _data(nullptr),
+        _size(0)
+    {
+    }
+
+    virtual ~MappedFile()
+    {
+        if (_data)
+        {
+            munmap(_data, _size);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    bool open(const std::string &filename)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        const bool ok = open(fd);
+        ::close(fd);
+
+        return ok;
+    }
+
+    // map a regular file, fd stays owned by the caller
+    bool open(int fd)
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            return false;
+        }
+
+        _size = static_cast<size_t>(st.st_size);
+        if (_size > 0)
+        {
+            void *p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                _size = 0;
+                return false;
+            }
+            _data = p;
+
+            // pages are read once front to back, let the kernel drop them behind us
+            madvise(_data, _size, MADV_SEQUENTIAL);
+        }
+
+        return true;
+    }
+
+    // whether fd can be mapped, pipes and terminals have to be read
+    static bool mappable(int fd)
+    {
+        struct stat st;
+        return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(static_cast<const char*>(_data), _size);
+    }
+
+    // drop the pages before upTo from RSS, they are re-read from the file if touched
+    void release(const char *upTo)
+    {
+        release(static_cast<const char*>(_data), upTo);
+    }
+
+    // same for the whole pages inside [from, upTo)
+    void release(const char *from, const char *upTo)
+    {
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t first = (static_cast<size_t>(from - static_cast<const char*>(_data)) + page - 1) / page * page;
+        const size_t last = static_cast<size_t>(upTo - static_cast<const char*>(_data)) / page * page;
+        if (last > first)
+        {
+            madvise(static_cast<char*>(_data) + first, last - first, MADV_DONTNEED);
+        }
+    }
+
+private :
+    void *_data;
+    size_t _size;
+};
+
+/* append-only string storage, interned views stay valid until destruction */
+class StringArena
+{
+public :
+    StringArena() :
+        _used(BLOCK),
+        _bytes(0)
+    {
+    }
+
+    StringArena(const StringArena&) = delete;
+    StringArena &operator=(const StringArena&) = delete;
+    StringArena(StringArena&&) = default;
+    StringArena &operator=(StringArena&&) = default;
+
+    std::string_view intern(std::string_view s)
+    {
+        if (s.length() > BLOCK / 4)
+        {
+            // big strings get a block of their own, the current one stays open
+            _big.emplace_back(new char[s.length()]);
+            std::memcpy(_big.back().get(), s.data(), s.length());
+            _bytes += s.length();
+            return std::string_view(_big.back().get(), s.length());
+        }
+
+        // the first key opens a block too, even an empty one
+        if (_blocks.empty() || _used + s.length() > BLOCK)
+        {
+            _blocks.emplace_back(new char[BLOCK]);
+            _used = 0;
+        }
+        char *dst = _blocks.back().get() + _used;
+        std::memcpy(dst, s.data(), s.length());
+        _used += s.length();
+        _bytes += s.length();
+        return std::string_view(dst, s.length());
+    }
+
+    size_t bytes() const
+    {
+        return _bytes;
+    }
+
+private :
+    static const size_t BLOCK = 1 << 20;
+
+    std::vector<std::unique_ptr<char[]>> _blocks;
+    std::vector<std::unique_ptr<char[]>> _big;
+    size_t _used;
+    size_t _bytes;
 };
 
 class CSV
@@ -97,6 +340,8 @@ public :
 
     static Data parse(std::string_view content, char delimiter = ',')
     {
+        STATS_TIMER("parse");
+        STATS_ADD("bytes", content.length());
         Data data;
 
         if (content.empty())
@@ -186,99 +431,1583 @@ public :
             current_row.push_back(std::move(current_field));
             data.rows.push_back(std::move(current_row));
         }
+        STATS_ADD("rows", data.rows.size());
 
         return data;
     }
 
-    static Data read(const std::string &filename, char delimiter = ',')
+    /*
+        Streaming form of parse(). onRow(fields) is called once per row with
+        string_views that are only valid during the call. Unquoted fields
+        point into content; quoted ones are unescaped into scratch strings
+        that are reused from row to row. onConsumed(ptr) is called at row
+        boundaries every CONSUMED_STEP bytes, everything before ptr will not
+        be read again.
+    */
+    typedef std::vector<std::string_view> Fields;
+    static const size_t CONSUMED_STEP = 64 << 20;
+    static const size_t MIN_CHUNK = 1 << 20;    // smaller inputs are not worth a thread
+
+    template <typename F>
+    static void scan(std::string_view content, char delimiter, F &&onRow)
     {
-        Data data;
+        scan(content, delimiter, onRow, [](const char *) {});
+    }
 
-        std::ifstream ifs(filename);
-        if (!ifs.is_open())
+    template <typename F, typename G>
+    static void scan(std::string_view content, char delimiter, F &&onRow, G &&onConsumed)
+    {
+        const char *ptr = content.data();
+        const char *end = ptr + content.length();
+
+        Fields row;
+        std::deque<std::string> scratch;    // stable addresses, one per field index
+
+        const char *fieldBegin = ptr;
+        const char *reported = ptr;
+        std::string *quoted = nullptr;      // set once the field needed unescaping
+
+        auto endField = [&]()
         {
-            data.success = false;
-            data.msg = "Fail open file.";
+            row.push_back(quoted ? std::string_view(*quoted) : std::string_view(fieldBegin, ptr - fieldBegin));
+            quoted = nullptr;
+        };
 
-            return data;
+        while (ptr < end)
+        {
+            char ch = (*ptr);
+
+            // case 1: open quote
+            if (ch == '"')
+            {
+                if (!quoted)
+                {
+                    if (scratch.size() <= row.size())
+                    {
+                        scratch.resize(row.size() + 1);
+                    }
+                    quoted = &scratch[row.size()];
+                    quoted->assign(fieldBegin, ptr);
+                }
+                ++ptr;
+
+                // loop until closing found
+                while (ptr < end)
+                {
+                    ch = (*ptr);
+                    ++ptr;
+
+                    if (ch == '"')
+                    {
+                        if ((ptr < end) && *ptr == '"')
+                        {
+                            *quoted += '"';
+                            ++ptr;
+                        }
+                        else
+                        {
+                            break;
+                        }
+                    }
+                    else
+                    {
+                        *quoted += ch;
+                    }
+                }
+
+                while (ptr < end && (*ptr == '\t' || *ptr == ' '))
+                {
+                    ++ptr;
+                }
+            }
+            // case 2: field delimiter
+            else if (ch == delimiter)
+            {
+                endField();
+                ++ptr;
+                fieldBegin = ptr;
+            }
+            // case 3: new line
+            else if (ch == '\r' || ch == '\n')
+            {
+                endField();
+                onRow(static_cast<const Fields&>(row));
+                row.clear();
+
+                if (ch == '\r' && (ptr+1 < end && (*(ptr+1) == '\n')))
+                {
+                    ++ptr;
+                }
+
+                ++ptr;
+                fieldBegin = ptr;
+
+                if (static_cast<size_t>(ptr - reported) >= CONSUMED_STEP)
+                {
+                    onConsumed(ptr);
+                    reported = ptr;
+                }
+            }
+            // case 4: normal character
+            else
+            {
+                if (quoted)
+                {
+                    *quoted += ch;
+                }
+                ++ptr;
+            }
         }
 
-        std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        if ((quoted ? !quoted->empty() : ptr > fieldBegin) || !row.empty())
+        {
+            endField();
+            onRow(static_cast<const Fields&>(row));
+        }
+    }
 
-        return parse(content, delimiter);
+    /*
+        Structural bitmaps for one 64-byte block, bit i is byte i. The
+        quote state is carried from block to block: inside has a bit set
+        for every byte between an opening quote and its closing quote.
+    */
+    struct Block {
+        uint64_t quote;
+        uint64_t delimiter;
+        uint64_t newline;       // '\n' or '\r'
+    };
+
+    static inline uint64_t prefixXor(uint64_t x)
+    {
+        // bit i becomes the xor of bits 0..i
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
     }
 
-    typedef std::deque<std::pair<std::string, long double>> AggType;
-    static AggType aggregrate(const Data &data)
+    static inline void classify(const char *p, char delimiter, Block &b)
     {
-        AggType result;
-        std::unordered_map<std::string, int> order;
-        int size = 0;
+#if defined(__SSE2__)
+        const __m128i q = _mm_set1_epi8('"');
+        const __m128i d = _mm_set1_epi8(delimiter);
+        const __m128i n = _mm_set1_epi8('\n');
+        const __m128i r = _mm_set1_epi8('\r');
 
-        auto iter = data.rows.cbegin();
-        while (iter != data.rows.cend())
+        b.quote = b.delimiter = b.newline = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * k));
+            const int shift = 16 * k;
+            b.quote |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, q)))) << shift;
+            b.delimiter |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, d)))) << shift;
+            b.newline |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(v, n), _mm_cmpeq_epi8(v, r))))) << shift;
+        }
+#elif defined(__aarch64__)
+        const uint8x16_t q = vdupq_n_u8('"');
+        const uint8x16_t d = vdupq_n_u8(static_cast<uint8_t>(delimiter));
+        const uint8x16_t n = vdupq_n_u8('\n');
+        const uint8x16_t r = vdupq_n_u8('\r');
+        static const uint8_t weight[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        const uint8x16_t w = vld1q_u8(weight);
+
+        // 16 compare lanes -> 16 bits
+        auto movemask = [&w](uint8x16_t m) -> uint64_t
+        {
+            const uint8x16_t t = vandq_u8(m, w);
+            const uint8x8_t lo = vget_low_u8(t), hi = vget_high_u8(t);
+            return static_cast<uint64_t>(vaddv_u8(lo)) | (static_cast<uint64_t>(vaddv_u8(hi)) << 8);
+        };
+
+        b.quote = b.delimiter = b.newline = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p + 16 * k));
+            const int shift = 16 * k;
+            b.quote |= movemask(vceqq_u8(v, q)) << shift;
+            b.delimiter |= movemask(vceqq_u8(v, d)) << shift;
+            b.newline |= movemask(vorrq_u8(vceqq_u8(v, n), vceqq_u8(v, r))) << shift;
+        }
+#else
+        b.quote = b.delimiter = b.newline = 0;
+        for (int i = 0; i < 64; ++i)
         {
-            const std::string &name = (*iter)[1];
-            long double value = std::strtold((*iter)[2].c_str(), NULL);
-            auto loc = order.find(name);
-            if (loc != order.end())
+            const uint64_t bit = 1ull << i;
+            if (p[i] == '"') b.quote |= bit;
+            else if (p[i] == delimiter) b.delimiter |= bit;
+            else if (p[i] == '\n' || p[i] == '\r') b.newline |= bit;
+        }
+#endif
+    }
+
+    // parse()'s rules for a field that contains quotes, applied to the raw bytes
+    static std::string_view unquote(std::string_view raw, std::string &out)
+    {
+        out.clear();
+
+        size_t i = 0;
+        while (i < raw.length())
+        {
+            char ch = raw[i++];
+            if (ch != '"')
             {
-                result[loc->second].second += value;
+                out += ch;
+                continue;
             }
-            else
+
+            // loop until closing found
+            while (i < raw.length())
             {
-                order[name] = size++;
-                result.push_back(std::make_pair(name, value));
+                ch = raw[i++];
+                if (ch == '"')
+                {
+                    if (i < raw.length() && raw[i] == '"')
+                    {
+                        out += '"';
+                        ++i;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+                else
+                {
+                    out += ch;
+                }
+            }
+
+            while (i < raw.length() && (raw[i] == '\t' || raw[i] == ' '))
+            {
+                ++i;
             }
-            
-            ++iter;
         }
 
-        return result;
+        return std::string_view(out);
     }
 
-    static void print(AggType &agg, bool sorted, int K)
+    /*
+        Fused form of scan() for aggregation. Only the columns listed in
+        wanted are captured, every other field is stepped over in place, so
+        no row is ever built up. onRow(picked, count) gets the captured
+        fields in the order of wanted (empty when the row is shorter) and
+        the number of fields in the row.
+
+        The input is classified 64 bytes at a time and only the structural
+        bytes are visited: delimiters and newlines outside quotes end
+        fields, quotes just mark the field for unquote(). A byte is inside
+        quotes iff an odd number of quotes precede it, which is what the
+        prefix xor of the quote bitmap gives.
+    */
+    template <typename F, typename G>
+    static void scanColumns(std::string_view content, char delimiter, const std::vector<int> &wanted, F &&onRow, G &&onConsumed)
     {
-        // copy to vector
-        std::vector<int> order(agg.size());
-        std::iota(order.begin(), order.end(), 0);
+        const char *begin = content.data();
+        const size_t length = content.length();
 
-        if (sorted)
+        // column -> capture slot, -1 for skipped columns
+        std::vector<int> slotOf;
+        for (size_t k = 0; k < wanted.size(); ++k)
         {
-            // sort according to agg[i].first and put the result to order
-            std::sort(order.begin(), order.end(),
-                [&agg](int a, int b)
+            if (static_cast<int>(slotOf.size()) <= wanted[k])
+            {
+                slotOf.resize(wanted[k] + 1, -1);
+            }
+            slotOf[wanted[k]] = static_cast<int>(k);
+        }
+        const int lastWanted = static_cast<int>(slotOf.size()) - 1;
+
+        std::vector<std::string_view> picked(wanted.size());
+        std::vector<std::string> scratch(wanted.size());   // never resized, one per slot
+
+        int column = 0;
+        int slot = lastWanted >= 0 ? slotOf[0] : -1;
+        size_t fieldBegin = 0;
+        size_t reported = 0;
+        size_t skipNewline = SIZE_MAX;      // the '\n' of a "\r\n" pair
+        bool hasQuote = false;
+
+        auto endField = [&](size_t fieldEnd)
+        {
+            if (slot >= 0)
+            {
+                const std::string_view raw(begin + fieldBegin, fieldEnd - fieldBegin);
+                picked[slot] = hasQuote ? unquote(raw, scratch[slot]) : raw;
+            }
+            hasQuote = false;
+        };
+
+        auto nextColumn = [&](int c)
+        {
+            column = c;
+            slot = column <= lastWanted ? slotOf[column] : -1;
+        };
+
+        char tail[64];
+        uint64_t inQuote = 0;       // all ones while a quoted field spans blocks
+        for (size_t base = 0; base < length; base += 64)
+        {
+            const char *p = begin + base;
+            if (length - base < 64)
+            {
+                // zero padding never matches
+                std::memset(tail, 0, sizeof(tail));
+                std::memcpy(tail, p, length - base);
+                p = tail;
+            }
+
+            Block b;
+            classify(p, delimiter, b);
+            const uint64_t inside = prefixXor(b.quote) ^ inQuote;
+            inQuote = static_cast<uint64_t>(0) - (inside >> 63);
+
+            uint64_t bits = ((b.delimiter | b.newline) & ~inside) | b.quote;
+            while (bits)
+            {
+                const size_t pos = base + __builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                const char ch = begin[pos];
+                if (ch == '"')
                 {
-                    return agg[a].first < agg[b].first;
+                    hasQuote = true;
                 }
-            );
-        }   
+                else if (ch == delimiter)
+                {
+                    endField(pos);
+                    nextColumn(column + 1);
+                    fieldBegin = pos + 1;
+                }
+                else if (pos == skipNewline)
+                {
+                    fieldBegin = pos + 1;
+                }
+                else
+                {
+                    endField(pos);
+                    onRow(static_cast<const std::string_view*>(picked.data()), column + 1);
+                    std::fill(picked.begin(), picked.end(), std::string_view());
+                    nextColumn(0);
 
-        long i = 0;
-        while (i < static_cast<long>(agg.size()) && (K == -1 || i < K))
+                    if (ch == '\r')
+                    {
+                        skipNewline = pos + 1;
+                    }
+                    fieldBegin = pos + 1;
+
+                    if (fieldBegin - reported >= CONSUMED_STEP)
+                    {
+                        onConsumed(begin + fieldBegin);
+                        reported = fieldBegin;
+                    }
+                }
+            }
+        }
+
+        if (fieldBegin < length || column > 0)
         {
-            std::cout << agg[order[i]].first << ":" << agg[order[i]].second << std::endl;
-            ++i;
+            std::string last;
+            const std::string_view raw(begin + fieldBegin, length - fieldBegin);
+            if ((hasQuote ? !unquote(raw, last).empty() : !raw.empty()) || column > 0)
+            {
+                endField(length);
+                onRow(static_cast<const std::string_view*>(picked.data()), column + 1);
+            }
         }
     }
 
-private :
-};
+    static Data read(const std::string &filename, char delimiter = ',')
+    {
+        STATS_TIMER("read");
+        Data data;
 
-int main(int argc, char *argv[])
+        std::ifstream ifs(filename);
+        if (!ifs.is_open())
+        {
+            data.success = false;
+            data.msg = "Fail open file.";
+
+            return data;
+        }
+
+        std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+        return parse(content, delimiter);
+    }
+
+    static inline uint64_t hashBytes(std::string_view s)
+    {
+        // 8 bytes at a time, multiply-xorshift mixing
+        uint64_t h = 0x9e3779b97f4a7c15ull ^ s.length();
+        const char *p = s.data();
+        size_t n = s.length();
+        while (n >= 8)
+        {
+            uint64_t w;
+            std::memcpy(&w, p, 8);
+            h = (h ^ w) * 0xbf58476d1ce4e5b9ull;
+            h ^= h >> 31;
+            p += 8;
+            n -= 8;
+        }
+        if (n > 0)
+        {
+            uint64_t w = 0;
+            std::memcpy(&w, p, n);
+            h = (h ^ w) * 0x94d049bb133111ebull;
+        }
+        h ^= h >> 29;
+        h *= 0xbf58476d1ce4e5b9ull;
+        return h ^ (h >> 32);
+    }
+
+    /*
+        Exact total of decimal amounts: whole numbers of 10^-FIXED_DIGITS
+        in fixed, plus a long double rest for the amounts that do not fit
+        (too many decimals, exponents, anything strtold() accepts but
+        parseFixed() does not) and for --float mode.
+    */
+    static const int FIXED_DIGITS = 6;
+    static const int64_t FIXED_SCALE = 1000000;
+
+    struct Total {
+        __int128 fixed = 0;
+        long double rest = 0;
+
+        Total &operator+=(const Total &other)
+        {
+            fixed += other.fixed;
+            rest += other.rest;
+            return *this;
+        }
+
+        long double value() const
+        {
+            if (fixed == 0)
+            {
+                return rest;
+            }
+            const __int128 whole = fixed / FIXED_SCALE;
+            const __int128 part = fixed % FIXED_SCALE;
+            return static_cast<long double>(whole) + static_cast<long double>(part) / FIXED_SCALE + rest;
+        }
+    };
+
+    // everything --agg can ask for, kept for every group in one pass
+    struct Stats {
+        Total sum;
+        int64_t count = 0;
+        double min = HUGE_VAL;
+        double max = -HUGE_VAL;
+
+        void add(double value)
+        {
+            ++count;
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+
+        Stats &operator+=(const Stats &other)
+        {
+            sum += other.sum;
+            count += other.count;
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+            return *this;
+        }
+
+        long double mean() const
+        {
+            return count ? sum.value() / count : 0;
+        }
+    };
+
+    typedef std::deque<std::pair<std::string, Stats>> AggType;
+
+    /*
+        Running stats in first-seen order. Entries sit in one vector in
+        insertion order with the stats inline; names are interned in an
+        arena. Lookup is an open-addressing index of entry numbers with
+        linear probing, kept at most half full.
+    */
+    class Aggregator
+    {
+    public :
+        Aggregator() :
+            _mask(0)
+        {
+        }
+
+        void add(std::string_view name, long double value)
+        {
+            Stats &s = stats(name);
+            s.sum.rest += value;
+            s.add(static_cast<double>(value));
+        }
+
+        void add(std::string_view name, int64_t fixed)
+        {
+            Stats &s = stats(name);
+            s.sum.fixed += fixed;
+            s.add(static_cast<double>(fixed) / FIXED_SCALE);
+        }
+
+        void add(std::string_view name, const Stats &value)
+        {
+            stats(name) += value;
+        }
+
+        // fold other in after everything seen so far
+        void merge(const Aggregator &other)
+        {
+            for (auto &entry : other._entries)
+            {
+                add(entry.name, entry.stats);
+            }
+        }
+
+        // f(name, stats) for every entry in first-seen order
+        template <typename F>
+        void forEach(F &&f) const
+        {
+            for (auto &entry : _entries)
+            {
+                f(entry.name, entry.stats);
+            }
+        }
+
+        size_t size() const
+        {
+            return _entries.size();
+        }
+
+        // share of index slots in use
+        double loadFactor() const
+        {
+            return _slots.empty() ? 0 : static_cast<double>(_entries.size()) / _slots.size();
+        }
+
+        AggType result() const
+        {
+            AggType agg;
+            for (auto &entry : _entries)
+            {
+                agg.push_back(std::make_pair(std::string(entry.name), entry.stats));
+            }
+            return agg;
+        }
+
+    private :
+        struct Entry {
+            std::string_view name;
+            uint64_t hash;
+            Stats stats;
+        };
+
+        static constexpr uint32_t EMPTY = 0xffffffffu;
+
+        Stats &stats(std::string_view name)
+        {
+            const uint64_t h = hashBytes(name);
+            if (_slots.empty())
+            {
+                grow();
+            }
+
+            size_t i = h & _mask;
+            while (_slots[i] != EMPTY)
+            {
+                Entry &e = _entries[_slots[i]];
+                if (e.hash == h && e.name == name)
+                {
+                    return e.stats;
+                }
+                i = (i + 1) & _mask;
+            }
+
+            _slots[i] = static_cast<uint32_t>(_entries.size());
+            _entries.push_back(Entry{ _names.intern(name), h, Stats() });
+            if (_entries.size() * 2 > _slots.size())
+            {
+                grow();
+            }
+            return _entries.back().stats;
+        }
+
+        void grow()
+        {
+            const size_t size = _slots.empty() ? 1024 : _slots.size() * 2;
+            _slots.assign(size, EMPTY);
+            _mask = size - 1;
+
+            for (size_t k = 0; k < _entries.size(); ++k)
+            {
+                size_t i = _entries[k].hash & _mask;
+                while (_slots[i] != EMPTY)
+                {
+                    i = (i + 1) & _mask;
+                }
+                _slots[i] = static_cast<uint32_t>(k);
+            }
+        }
+
+        std::vector<Entry> _entries;
+        std::vector<uint32_t> _slots;
+        size_t _mask;
+        StringArena _names;
+    };
+
+    static AggType aggregrate(const Data &data)
+    {
+        STATS_TIMER("aggregate");
+        Aggregator agg;
+
+        auto iter = data.rows.cbegin();
+        while (iter != data.rows.cend())
+        {
+            if (iter->size() > 2)
+            {
+                agg.add((*iter)[1], std::strtold((*iter)[2].c_str(), NULL));
+            }
+            ++iter;
+        }
+        tableStats(agg);
+
+        return agg.result();
+    }
+
+    struct Summary {
+        AggType agg;
+        bool success = true;
+        std::string msg;
+    };
+
+    // strtold() wants a terminated string, copy short fields to the stack
+    static long double parseAmount(std::string_view field, std::string &spill)
+    {
+        char buffer[64];
+        if (field.length() < sizeof(buffer))
+        {
+            std::memcpy(buffer, field.data(), field.length());
+            buffer[field.length()] = '\0';
+            return std::strtold(buffer, NULL);
+        }
+
+        spill.assign(field);
+        return std::strtold(spill.c_str(), NULL);
+    }
+
+    /*
+        [blanks][+-]digits[.digits][blanks] with at most 12 integer and
+        FIXED_DIGITS fraction digits, as a count of 10^-FIXED_DIGITS.
+        Anything else returns false and is left to strtold().
+    */
+    static bool parseFixed(std::string_view field, int64_t &value)
+    {
+        const char *p = field.data();
+        const char *end = p + field.length();
+
+        while (p < end && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        int64_t whole = 0;
+        int digits = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            if (++digits > 12)
+            {
+                return false;
+            }
+            whole = whole * 10 + (*p - '0');
+            ++p;
+        }
+
+        int64_t part = 0;
+        int decimals = 0;
+        if (p < end && *p == '.')
+        {
+            ++p;
+            while (p < end && *p >= '0' && *p <= '9')
+            {
+                if (++decimals > FIXED_DIGITS)
+                {
+                    return false;
+                }
+                part = part * 10 + (*p - '0');
+                ++p;
+            }
+        }
+        if (digits + decimals == 0)
+        {
+            return false;
+        }
+
+        while (p < end && (*p == ' ' || *p == '\t'))
+        {
+            ++p;
+        }
+        if (p != end)
+        {
+            return false;
+        }
+
+        for (int i = decimals; i < FIXED_DIGITS; ++i)
+        {
+            part *= 10;
+        }
+        value = whole * FIXED_SCALE + part;
+        if (negative)
+        {
+            value = -value;
+        }
+        return true;
+    }
+
+    /*
+        Split content into at most parts ranges that each start at a row.
+        A byte is inside quotes iff an odd number of '"' precede it (an
+        escaped "" toggles twice), so the quotes of every raw slice are
+        counted in parallel and each cut is then moved forward to the first
+        newline outside quotes.
+    */
+    static std::vector<std::string_view> splitRows(std::string_view content, int parts)
+    {
+        const char *begin = content.data();
+        const char *end = begin + content.length();
+
+        std::vector<const char*> raw(parts + 1);
+        for (int i = 0; i <= parts; ++i)
+        {
+            raw[i] = begin + content.length() * i / parts;
+        }
+
+        std::vector<size_t> quotes(parts);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < parts; ++i)
+        {
+            workers.emplace_back([&raw, &quotes, i]()
+            {
+                quotes[i] = std::count(raw[i], raw[i + 1], '"');
+            });
+        }
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+
+        std::vector<std::string_view> ranges;
+        const char *from = begin;
+        bool inQuote = false;
+        for (int i = 1; i <= parts; ++i)
+        {
+            inQuote ^= (quotes[i - 1] & 1) != 0;
+
+            const char *cut = end;
+            if (i < parts)
+            {
+                cut = std::max(rowStart(raw[i], end, inQuote), from);
+            }
+            if (cut > from)
+            {
+                ranges.push_back(std::string_view(from, cut - from));
+            }
+            from = cut;
+        }
+
+        return ranges;
+    }
+
+    // first byte after the next row end at or after p
+    static const char *rowStart(const char *p, const char *end, bool inQuote)
+    {
+        while (p < end)
+        {
+            const char ch = *p++;
+            if (ch == '"')
+            {
+                inQuote = !inQuote;
+            }
+            else if (!inQuote && (ch == '\n' || ch == '\r'))
+            {
+                if (ch == '\r' && p < end && *p == '\n')
+                {
+                    ++p;
+                }
+                return p;
+            }
+        }
+        return end;
+    }
+
+    // --key items besides column numbers, both bucket the date in column 0
+    static constexpr int KEY_DAY = -1;
+    static constexpr int KEY_MONTH = -2;
+
+    struct Settings {
+        char delimiter = ',';
+        int threads = 1;
+        bool useFloat = false;      // sum in long double instead of fixed point
+        std::vector<int> key = {1}; // group by these columns, joined with ','
+        int value = 2;              // amount column
+        std::string state;          // snapshot for incremental runs, empty for none
+    };
+
+    // "1", "3,1", "month,1": column numbers or day/month of column 0
+    static bool parseKey(const std::string &spec, std::vector<int> &key)
+    {
+        key.clear();
+        size_t begin = 0;
+        while (begin <= spec.length())
+        {
+            size_t end = spec.find(',', begin);
+            if (end == std::string::npos)
+            {
+                end = spec.length();
+            }
+
+            const std::string item = spec.substr(begin, end - begin);
+            if (item == "day")
+            {
+                key.push_back(KEY_DAY);
+            }
+            else if (item == "month")
+            {
+                key.push_back(KEY_MONTH);
+            }
+            else if (!item.empty() && item.length() < 6 && item.find_first_not_of("0123456789") == std::string::npos)
+            {
+                key.push_back(std::atoi(item.c_str()));
+            }
+            else
+            {
+                return false;
+            }
+            begin = end + 1;
+        }
+        return !key.empty();
+    }
+
+    enum Measure {MEASURE_SUM, MEASURE_COUNT, MEASURE_MIN, MEASURE_MAX, MEASURE_MEAN};
+
+    // "sum,count,min,max,mean" in any order and subset
+    static bool parseMeasures(const std::string &spec, std::vector<Measure> &measures)
+    {
+        static const char *names[] = { "sum", "count", "min", "max", "mean" };
+
+        measures.clear();
+        size_t begin = 0;
+        while (begin <= spec.length())
+        {
+            size_t end = spec.find(',', begin);
+            if (end == std::string::npos)
+            {
+                end = spec.length();
+            }
+
+            const std::string item = spec.substr(begin, end - begin);
+            const auto found = std::find_if(std::begin(names), std::end(names),
+                [&item](const char *name) { return item == name; });
+            if (found == std::end(names))
+            {
+                return false;
+            }
+            measures.push_back(static_cast<Measure>(found - std::begin(names)));
+            begin = end + 1;
+        }
+        return true;
+    }
+
+    // the part of a field that goes into the key
+    static std::string_view keyPart(std::string_view field, int key)
+    {
+        if (key == KEY_DAY)
+        {
+            return field.substr(0, 10);     // YYYY-MM-DD
+        }
+        if (key == KEY_MONTH)
+        {
+            return field.substr(0, 7);      // YYYY-MM
+        }
+        return field;
+    }
+
+    // key and value columns only, nothing else in the row is looked at
+    static void aggregrate(std::string_view content, const Settings &settings, Aggregator &agg, MappedFile *file)
+    {
+        STATS_TIMER("aggregate");
+        STATS_ADD("bytes", content.length());
+
+        // the value is captured first, then every key column once
+        std::vector<int> wanted = { settings.value };
+        std::vector<int> keySlot;
+        for (int k : settings.key)
+        {
+            const int column = k < 0 ? 0 : k;
+            auto found = std::find(wanted.begin(), wanted.end(), column);
+            keySlot.push_back(static_cast<int>(found - wanted.begin()));
+            if (found == wanted.end())
+            {
+                wanted.push_back(column);
+            }
+        }
+        const int needed = *std::max_element(wanted.begin(), wanted.end()) + 1;
+        const bool plainKey = (settings.key.size() == 1 && settings.key[0] >= 0);
+
+        const char *from = content.data();
+        std::string longAmount;
+        std::string key;
+        size_t rows = 0;
+        scanColumns(content, settings.delimiter, wanted, [&](const std::string_view *fields, int count)
+        {
+            ++rows;
+            if (count < needed)
+            {
+                return;
+            }
+
+            std::string_view name = fields[keySlot[0]];
+            if (!plainKey)
+            {
+                key.clear();
+                for (size_t i = 0; i < settings.key.size(); ++i)
+                {
+                    if (i > 0)
+                    {
+                        key += ',';
+                    }
+                    const std::string_view part = keyPart(fields[keySlot[i]], settings.key[i]);
+                    key.append(part.data(), part.length());
+                }
+                name = key;
+            }
+
+            int64_t fixed;
+            if (!settings.useFloat && parseFixed(fields[0], fixed))
+            {
+                agg.add(name, fixed);
+            }
+            else
+            {
+                agg.add(name, parseAmount(fields[0], longAmount));
+            }
+        },
+        [&](const char *ptr)
+        {
+            if (file)
+            {
+                file->release(from, ptr);
+            }
+            from = ptr;
+        });
+        STATS_ADD("rows", rows);
+    }
+
+    // same, split over settings.threads and merged into agg in file order
+    static void aggregrateParallel(std::string_view content, const Settings &settings, Aggregator &agg, MappedFile *file)
+    {
+        if (settings.threads <= 1 || content.length() < MIN_CHUNK)
+        {
+            aggregrate(content, settings, agg, file);
+            return;
+        }
+
+        // one partial table per chunk, each chunk is a run of whole rows
+        const int parts = static_cast<int>(std::min<size_t>(settings.threads, content.length() / MIN_CHUNK));
+        const std::vector<std::string_view> chunks = splitRows(content, parts);
+        std::vector<Aggregator> partial(chunks.size());
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            workers.emplace_back([&, i]()
+            {
+                aggregrate(chunks[i], settings, partial[i], file);
+            });
+        }
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+
+        // merging in file order keeps first-seen order
+        for (auto &p : partial)
+        {
+            agg.merge(p);
+        }
+    }
+
+    /*
+        State file, host byte order:
+
+            "AGGSTATE" u32 version u32 sizeof(long double)
+            u64 offset u64 prefix hash u32 n, n bytes of layout
+            u64 entries, then per entry
+                u32 n, n bytes of name, 16 bytes fixed, long double rest,
+                i64 count, double min, double max
+
+        offset is always at a row boundary. The prefix hash covers the
+        first and the last PREFIX_WINDOW bytes before offset: rehashing
+        the whole prefix would cost as much as parsing it again, and a
+        rewritten or rotated file almost always changes one of the two.
+    */
+    static constexpr uint32_t STATE_VERSION = 2;
+    static constexpr size_t PREFIX_WINDOW = 64 << 10;
+
+    static uint64_t prefixHash(std::string_view content, size_t offset)
+    {
+        const size_t head = std::min(offset, PREFIX_WINDOW);
+        const size_t tail = std::min(offset, PREFIX_WINDOW);
+        uint64_t h = hashBytes(content.substr(0, head));
+        h ^= hashBytes(content.substr(offset - tail, tail)) * 0x9e3779b97f4a7c15ull;
+        return h ^ offset;
+    }
+
+    // what the table was built from, a state is only reused for the same layout
+    static std::string stateLayout(const Settings &settings)
+    {
+        std::string layout = "key=";
+        for (int k : settings.key)
+        {
+            layout += std::to_string(k) + ",";
+        }
+        layout += ";value=" + std::to_string(settings.value);
+        layout += std::string(";delimiter=") + settings.delimiter;
+        return layout;
+    }
+
+    template <typename T>
+    static void putRaw(std::ostream &os, const T &value)
+    {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool getRaw(std::istream &is, T &value)
+    {
+        return static_cast<bool>(is.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    // write to a temporary and rename, a crash never leaves a torn state
+    static bool saveState(const std::string &path, const std::string &layout, uint64_t offset, uint64_t hash, const Aggregator &agg)
+    {
+        STATS_TIMER("save_state");
+        const std::string temp = path + ".tmp";
+        {
+            std::ofstream os(temp, std::ios::binary | std::ios::trunc);
+            if (!os)
+            {
+                return false;
+            }
+
+            os.write("AGGSTATE", 8);
+            putRaw(os, STATE_VERSION);
+            putRaw(os, static_cast<uint32_t>(sizeof(long double)));
+            putRaw(os, offset);
+            putRaw(os, hash);
+            putRaw(os, static_cast<uint32_t>(layout.length()));
+            os.write(layout.data(), layout.length());
+            putRaw(os, static_cast<uint64_t>(agg.size()));
+            agg.forEach([&os](std::string_view name, const Stats &stats)
+            {
+                putRaw(os, static_cast<uint32_t>(name.length()));
+                os.write(name.data(), name.length());
+                putRaw(os, stats.sum.fixed);
+                putRaw(os, stats.sum.rest);
+                putRaw(os, stats.count);
+                putRaw(os, stats.min);
+                putRaw(os, stats.max);
+            });
+
+            os.flush();
+            if (!os)
+            {
+                return false;
+            }
+        }
+
+        return std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+
+    /*
+        Load the state at path into agg and return the offset to resume
+        from. A missing file, a different layout or a prefix that no longer
+        matches content all mean starting again from 0 with an empty agg.
+    */
+    static size_t loadState(const std::string &path, const std::string &layout, std::string_view content, Aggregator &agg)
+    {
+        STATS_TIMER("load_state");
+        std::ifstream is(path, std::ios::binary);
+        if (!is)
+        {
+            return 0;
+        }
+
+        char magic[8];
+        uint32_t version = 0, ldSize = 0, layoutLength = 0;
+        uint64_t offset = 0, hash = 0, count = 0;
+        std::string stored;
+        bool ok = static_cast<bool>(is.read(magic, 8)) && std::memcmp(magic, "AGGSTATE", 8) == 0
+            && getRaw(is, version) && version == STATE_VERSION
+            && getRaw(is, ldSize) && ldSize == sizeof(long double)
+            && getRaw(is, offset) && getRaw(is, hash) && getRaw(is, layoutLength);
+        if (ok)
+        {
+            stored.resize(layoutLength);
+            ok = static_cast<bool>(is.read(&stored[0], layoutLength)) && stored == layout
+                && offset <= content.length() && prefixHash(content, offset) == hash
+                && getRaw(is, count);
+        }
+
+        std::string name;
+        for (uint64_t i = 0; ok && i < count; ++i)
+        {
+            uint32_t length = 0;
+            Stats stats;
+            ok = getRaw(is, length);
+            if (ok)
+            {
+                name.resize(length);
+                ok = static_cast<bool>(is.read(&name[0], length))
+                    && getRaw(is, stats.sum.fixed) && getRaw(is, stats.sum.rest)
+                    && getRaw(is, stats.count) && getRaw(is, stats.min) && getRaw(is, stats.max);
+            }
+            if (ok)
+            {
+                agg.add(name, stats);
+            }
+        }
+
+        if (!ok)
+        {
+            std::cerr << "State " << path << " does not match the input, starting over." << std::endl;
+            agg = Aggregator();
+            return 0;
+        }
+        return static_cast<size_t>(offset);
+    }
+
+    // end of the last complete row in content, from is a row start
+    static size_t lastRowEnd(std::string_view content, size_t from)
+    {
+        // quote parity is even at from, so a newline is a row end iff the
+        // number of quotes between from and it is even
+        size_t quotes = std::count(content.begin() + from, content.end(), '"');
+        size_t i = content.length();
+        while (i > from)
+        {
+            const char ch = content[i - 1];
+            if (ch == '"')
+            {
+                --quotes;
+            }
+            else if ((ch == '\n' || ch == '\r') && (quotes & 1) == 0)
+            {
+                return i;
+            }
+            --i;
+        }
+        return from;
+    }
+
+    /*
+        Aggregate a mapped file into agg.
+
+        With settings.state the table of the rows already seen is loaded
+        from the snapshot and only the bytes after its offset are parsed.
+        The snapshot is then rewritten up to the last complete row, a row
+        still being appended is counted in this result but parsed again
+        next time.
+    */
+    static bool aggregrateMapped(MappedFile &file, const Settings &settings, Aggregator &agg, std::string &msg)
+    {
+        const std::string_view content = file.view();
+        if (settings.state.empty())
+        {
+            aggregrateParallel(content, settings, agg, &file);
+            return true;
+        }
+
+        const std::string layout = stateLayout(settings);
+        const size_t offset = loadState(settings.state, layout, content, agg);
+        const size_t cut = lastRowEnd(content, offset);
+        aggregrateParallel(content.substr(offset, cut - offset), settings, agg, &file);
+
+        if (!saveState(settings.state, layout, cut, prefixHash(content, cut), agg))
+        {
+            msg = "Fail write state file.";
+            return false;
+        }
+
+        aggregrate(content.substr(cut), settings, agg, &file);
+        return true;
+    }
+
+    static const size_t STREAM_BUFFER = 4 << 20;
+
+    /*
+        Aggregate what can only be read front to back (stdin, pipes). The
+        buffer holds whole rows plus the start of the next one; it only
+        grows past STREAM_BUFFER for a single row that does not fit.
+    */
+    static bool aggregrateStream(int fd, const Settings &settings, Aggregator &agg, std::string &msg)
+    {
+        std::vector<char> buffer(STREAM_BUFFER);
+        size_t filled = 0;
+
+        while (true)
+        {
+            if (filled == buffer.size())
+            {
+                buffer.resize(buffer.size() * 2);
+            }
+
+            const ssize_t n = ::read(fd, buffer.data() + filled, buffer.size() - filled);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                msg = "Fail read input.";
+                return false;
+            }
+            if (n == 0)
+            {
+                break;
+            }
+            filled += static_cast<size_t>(n);
+
+            // pipes hand out small reads, parse once half the buffer is in
+            if (filled < buffer.size() / 2)
+            {
+                continue;
+            }
+
+            const std::string_view content(buffer.data(), filled);
+            const size_t cut = lastRowEnd(content, 0);
+            if (cut > 0)
+            {
+                aggregrate(content.substr(0, cut), settings, agg, nullptr);
+                std::memmove(buffer.data(), buffer.data() + cut, filled - cut);
+                filled -= cut;
+            }
+        }
+
+        aggregrate(std::string_view(buffer.data(), filled), settings, agg, nullptr);
+        return true;
+    }
+
+    // one input, "-" is stdin; regular files are mapped, anything else streamed
+    static bool aggregrateInput(const std::string &filename, const Settings &settings, Aggregator &agg, std::string &msg)
+    {
+        const bool isStdin = (filename == "-");
+        const int fd = isStdin ? STDIN_FILENO : ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            msg = "Fail open file: " + filename;
+            return false;
+        }
+
+        bool ok;
+        if (MappedFile::mappable(fd))
+        {
+            MappedFile file;
+            ok = file.open(fd);
+            if (ok)
+            {
+                ok = aggregrateMapped(file, settings, agg, msg);
+            }
+            else
+            {
+                msg = "Fail open file: " + filename;
+            }
+        }
+        else if (!settings.state.empty())
+        {
+            // a stream cannot be re-read from a saved offset
+            msg = "--state needs a regular file, not a pipe: " + filename;
+            ok = false;
+        }
+        else
+        {
+            ok = aggregrateStream(fd, settings, agg, msg);
+        }
+
+        if (!isStdin)
+        {
+            ::close(fd);
+        }
+        return ok;
+    }
+
+    /*
+        Aggregate all inputs as one stream, rows are never stored. Amounts
+        are summed exactly in fixed point unless useFloat asks for the
+        plain long double sum.
+
+        With more than one input and settings.threads > 1 the inputs are
+        parsed concurrently into one table each, the tables are merged in
+        argument order so first-seen order is the same as reading them one
+        after another. A single input uses the threads on its own chunks.
+    */
+    static Summary aggregrate(const std::vector<std::string> &filenames, const Settings &settings)
+    {
+        Summary summary;
+
+        if (filenames.size() <= 1 || settings.threads <= 1)
+        {
+            Aggregator agg;
+            for (auto &filename : filenames)
+            {
+                if (!aggregrateInput(filename, settings, agg, summary.msg))
+                {
+                    summary.success = false;
+                    return summary;
+                }
+            }
+            tableStats(agg);
+            summary.agg = agg.result();
+
+            return summary;
+        }
+
+        Settings single = settings;
+        single.threads = 1;
+
+        std::vector<Aggregator> partial(filenames.size());
+        std::vector<std::string> errors(filenames.size());
+        std::vector<char> ok(filenames.size(), 0);
+        std::atomic<size_t> next(0);
+
+        std::vector<std::thread> workers;
+        const size_t count = std::min<size_t>(settings.threads, filenames.size());
+        for (size_t w = 0; w < count; ++w)
+        {
+            workers.emplace_back([&]()
+            {
+                for (size_t i = next++; i < filenames.size(); i = next++)
+                {
+                    ok[i] = aggregrateInput(filenames[i], single, partial[i], errors[i]);
+                }
+            });
+        }
+        for (auto &w : workers)
+        {
+            w.join();
+        }
+
+        Aggregator agg;
+        for (size_t i = 0; i < filenames.size(); ++i)
+        {
+            if (!ok[i])
+            {
+                summary.success = false;
+                summary.msg = errors[i];
+                return summary;
+            }
+            agg.merge(partial[i]);
+            partial[i] = Aggregator();
+        }
+        tableStats(agg);
+        summary.agg = agg.result();
+
+        return summary;
+    }
+
+    // size of the final table for --stats
+    static void tableStats(const Aggregator &agg)
+    {
+        STATS_SET("groups", agg.size());
+        STATS_SET("table_load_factor", agg.loadFactor());
+    }
+
+    enum Order {ORDER_FIRST_SEEN, ORDER_NAME, ORDER_TOTAL};
+
+    /*
+        Print the first K entries (all for K == -1) in the given order as
+        key:value,value,... with one value per measure. ORDER_TOTAL is the
+        largest sum first, ties keep first-seen order. When K cuts the list
+        only the first K positions are sorted, a heap based partial_sort is
+        O(n log K).
+    */
+    static void print(AggType &agg, Order by, int K, const std::vector<Measure> &measures)
+    {
+        STATS_TIMER("print");
+        // copy to vector
+        std::vector<int> order(agg.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        const bool cut = (K >= 0 && K < static_cast<int>(order.size()));
+        auto sortOrder = [&order, K, cut](auto &&less)
+        {
+            if (cut)
+            {
+                std::partial_sort(order.begin(), order.begin() + K, order.end(), less);
+            }
+            else
+            {
+                std::sort(order.begin(), order.end(), less);
+            }
+        };
+
+        if (by == ORDER_NAME)
+        {
+            // sort according to agg[i].first and put the result to order
+            sortOrder([&agg](int a, int b)
+                {
+                    return agg[a].first < agg[b].first;
+                }
+            );
+        }
+        else if (by == ORDER_TOTAL)
+        {
+            std::vector<long double> total(agg.size());
+            for (size_t i = 0; i < agg.size(); ++i)
+            {
+                total[i] = agg[i].second.sum.value();
+            }
+
+            sortOrder([&total](int a, int b)
+                {
+                    if (total[a] != total[b])
+                    {
+                        return total[a] > total[b];
+                    }
+                    return a < b;
+                }
+            );
+        }
+
+        long i = 0;
+        while (i < static_cast<long>(agg.size()) && (K == -1 || i < K))
+        {
+            const Stats &stats = agg[order[i]].second;
+            std::cout << agg[order[i]].first << ":";
+            for (size_t m = 0; m < measures.size(); ++m)
+            {
+                if (m > 0)
+                {
+                    std::cout << ",";
+                }
+                switch (measures[m])
+                {
+                case MEASURE_SUM:
+                    std::cout << stats.sum.value();
+                    break;
+                case MEASURE_COUNT:
+                    std::cout << stats.count;
+                    break;
+                case MEASURE_MIN:
+                    std::cout << stats.min;
+                    break;
+                case MEASURE_MAX:
+                    std::cout << stats.max;
+                    break;
+                case MEASURE_MEAN:
+                    std::cout << stats.mean();
+                    break;
+                }
+            }
+            std::cout << std::endl;
+            ++i;
+        }
+    }
+
+private :
+};
+
+#ifndef AGG_BENCH
+int main(int argc, char *argv[])
 {
     struct Option opt;
     opt.get(argc, argv);
+
+    CSV::Order order = opt.sorted ? CSV::ORDER_NAME : CSV::ORDER_FIRST_SEEN;
+    if (opt.by == "name")
+    {
+        order = CSV::ORDER_NAME;
+    }
+    else if (opt.by == "total")
+    {
+        order = CSV::ORDER_TOTAL;
+    }
+    else if (!opt.by.empty())
+    {
+        std::cerr << "Unknown order: " << opt.by << std::endl;
+        return 1;
+    }
     
-    // read csv
-    CSV csv;
-    CSV::Data data = csv.read(opt.filename);
+    CSV::Settings settings;
+    if (!CSV::parseKey(opt.key, settings.key))
+    {
+        std::cerr << "Unknown key: " << opt.key << std::endl;
+        return 1;
+    }
+    if (opt.value < 0)
+    {
+        std::cerr << "Bad value column: " << opt.value << std::endl;
+        return 1;
+    }
+    settings.value = opt.value;
 
-    // calculate amount per category
-    CSV::AggType agg = csv.aggregrate(data);
+    std::vector<CSV::Measure> measures;
+    if (!CSV::parseMeasures(opt.aggs, measures))
+    {
+        std::cerr << "Unknown aggregate: " << opt.aggs << std::endl;
+        return 1;
+    }
+
+    if (opt.filenames.empty())
+    {
+        std::cerr << "No input file." << std::endl;
+        return 1;
+    }
+    if (!opt.state.empty() && (opt.filenames.size() != 1 || opt.filenames[0] == "-"))
+    {
+        std::cerr << "--state needs exactly one input file." << std::endl;
+        return 1;
+    }
+    
+    // read csv and calculate amount per category
+    CSV csv;
+    settings.threads = opt.threads;
+    settings.useFloat = opt.useFloat;
+    settings.state = opt.state;
+    CSV::Summary summary = csv.aggregrate(opt.filenames, settings);
+    if (!summary.success)
+    {
+        std::cerr << summary.msg << std::endl;
+        return 1;
+    }
 
     // print
-    csv.print(agg, opt.sorted, opt.k);
+    csv.print(summary.agg, order, opt.k, measures);
+
+    if (opt.stats)
+    {
+        if (STATS_ENABLED)
+        {
+            STATS_JSON(std::cerr);
+        }
+        else
+        {
+            std::cerr << "--stats needs a build with STATS=1" << std::endl;
+        }
+    }
 
     return 0;
 }
+#endif
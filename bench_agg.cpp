@@ -0,0 +1,365 @@
+/*
+    Benchmark: agg's parsing and aggregation paths on a synthetic ledger.
+
+    A date,category,amount file is generated first, then every stage is
+    timed on it separately. Each line reports seconds, MB/s of input and
+    the peak RSS of that stage alone (VmHWM is reset in between).
+
+    CLI:
+        bench_agg [--size MB] [--categories N] [--zipf S] [--quoted R]
+                  [--crlf] [--threads N] [--seed N] [--file path] [--keep]
+
+    --zipf 0 draws categories uniformly, larger S skews towards the first
+    ones. --quoted R is the fraction of rows whose category is a quoted
+    field with an embedded delimiter and an escaped quote.
+*/
+
+// everything agg.cpp includes, so its own #includes are no-ops inside the
+// namespace below
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// outside the namespaces, so there is one stats registry
+#include "stats.h"
+
+#define AGG_BENCH
+
+namespace agg {
+#include "agg.cpp"
+}
+
+struct Option {
+    Option() :
+        size(256),
+        categories(1000),
+        zipf(1.0),
+        quoted(0.05),
+        crlf(false),
+        threads(static_cast<int>(std::thread::hardware_concurrency())),
+        seed(1),
+        file("/tmp/bench_agg.csv"),
+        keep(false)
+    {
+    };
+
+    void get(int argc, char *argv[])
+    {
+        int c;
+        while (1)
+        {
+            static struct option longOpt[] = {
+                { "size", required_argument, 0, 's'},
+                { "categories", required_argument, 0, 'c'},
+                { "zipf", required_argument, 0, 'z'},
+                { "quoted", required_argument, 0, 'q'},
+                { "crlf", no_argument, 0, 'r'},
+                { "threads", required_argument, 0, 't'},
+                { "seed", required_argument, 0, 'S'},
+                { "file", required_argument, 0, 'f'},
+                { "keep", no_argument, 0, 'k'},
+                { 0, 0, 0, 0 }
+            };
+
+            int index = 0;
+
+            c = getopt_long(argc, argv, "", longOpt, &index);
+            if (c == -1)
+                break;
+
+            switch (c)
+            {
+            case 's':
+                size = std::atof(optarg);
+                break;
+            case 'c':
+                categories = std::atol(optarg);
+                break;
+            case 'z':
+                zipf = std::atof(optarg);
+                break;
+            case 'q':
+                quoted = std::atof(optarg);
+                break;
+            case 'r':
+                crlf = true;
+                break;
+            case 't':
+                threads = std::atoi(optarg);
+                break;
+            case 'S':
+                seed = std::atoll(optarg);
+                break;
+            case 'f':
+                file = optarg;
+                break;
+            case 'k':
+                keep = true;
+                break;
+            default:
+                std::cerr << "Unknown option" << std::endl;
+                break;
+            }
+        }
+
+        threads = std::max(threads, 1);
+        categories = std::max(categories, 1L);
+    }
+
+    double size;            // MB of CSV to generate
+    long categories;
+    double zipf;            // Zipf exponent, 0 is uniform
+    double quoted;          // fraction of quoted categories
+    bool crlf;
+    int threads;
+    long long seed;
+    std::string file;
+    bool keep;              // leave the generated file behind
+};
+
+/* date,category,amount rows until the file reaches the requested size */
+static bool generate(const Option &option)
+{
+    std::ofstream os(option.file, std::ios::binary | std::ios::trunc);
+    if (!os)
+    {
+        return false;
+    }
+
+    // category i has weight 1/(i+1)^s, drawn by binary search on the CDF
+    std::vector<double> cdf(option.categories);
+    double sum = 0;
+    for (long i = 0; i < option.categories; ++i)
+    {
+        sum += 1.0 / std::pow(static_cast<double>(i + 1), option.zipf);
+        cdf[i] = sum;
+    }
+
+    std::mt19937_64 gen(static_cast<uint64_t>(option.seed));
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<int> day(1, 28), cents(0, 99999);
+
+    const char *eol = option.crlf ? "\r\n" : "\n";
+    const size_t target = static_cast<size_t>(option.size * (1 << 20));
+    std::string buffer;
+    size_t written = 0;
+    char row[128];
+    while (written < target)
+    {
+        buffer.clear();
+        while (buffer.length() < (1 << 20))
+        {
+            const long cat = std::lower_bound(cdf.begin(), cdf.end(), unit(gen) * sum) - cdf.begin();
+            const int cent = cents(gen);
+            int n;
+            if (unit(gen) < option.quoted)
+            {
+                n = std::snprintf(row, sizeof(row), "2024-01-%02d,\"cat%ld, \"\"q\"\"\",%d.%02d%s",
+                                  day(gen), cat, cent / 100, cent % 100, eol);
+            }
+            else
+            {
+                n = std::snprintf(row, sizeof(row), "2024-01-%02d,cat%ld,%d.%02d%s",
+                                  day(gen), cat, cent / 100, cent % 100, eol);
+            }
+            buffer.append(row, n);
+        }
+        os.write(buffer.data(), buffer.length());
+        written += buffer.length();
+    }
+
+    return static_cast<bool>(os);
+}
+
+// peak RSS in kB since the last reset
+static long peakRss()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+        {
+            return std::atol(line.c_str() + 6);
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// start a new peak, writing 5 to clear_refs resets VmHWM (Linux 4.0+);
+// heap freed by earlier stages is handed back first so it does not count
+static void resetPeakRss()
+{
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+}
+
+/* swallows print() output so only formatting is timed */
+class NullBuffer : public std::streambuf
+{
+protected :
+    int overflow(int c) override
+    {
+        return c;
+    }
+
+    std::streamsize xsputn(const char *, std::streamsize n) override
+    {
+        return n;
+    }
+};
+
+static double mb = 0;   // input size in MB, for throughput
+
+template <typename F>
+static void stage(const std::string &name, F &&body)
+{
+    resetPeakRss();
+    const auto start = std::chrono::steady_clock::now();
+    body();
+    const auto stop = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(stop - start).count();
+
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+              << std::setw(10) << std::setprecision(3) << seconds
+              << std::setw(12) << std::setprecision(1) << mb / seconds
+              << std::setw(12) << peakRss() / 1024 << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    Option option;
+    option.get(argc, argv);
+
+    std::cout << "generating " << option.size << " MB, " << option.categories << " categories, zipf "
+              << option.zipf << ", quoted " << option.quoted << (option.crlf ? ", CRLF" : ", LF") << std::endl;
+    if (!generate(option))
+    {
+        std::cerr << "Fail write " << option.file << std::endl;
+        return 1;
+    }
+
+    struct stat st;
+    stat(option.file.c_str(), &st);
+    mb = static_cast<double>(st.st_size) / (1 << 20);
+
+    std::cout << std::left << std::setw(28) << "stage" << std::right
+              << std::setw(10) << "seconds" << std::setw(12) << "MB/s" << std::setw(12) << "peak MB" << std::endl;
+
+    typedef agg::CSV CSV;
+
+    stage("CSV::read", [&]()
+    {
+        CSV::read(option.file);
+    });
+
+    {
+        std::ifstream ifs(option.file, std::ios::binary);
+        const std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+        CSV::Data data;
+        stage("CSV::parse", [&]()
+        {
+            data = CSV::parse(content);
+        });
+        stage("aggregrate(Data)", [&]()
+        {
+            CSV::aggregrate(data);
+        });
+        stage("CSV::scan", [&]()
+        {
+            size_t fields = 0;
+            CSV::scan(content, ',', [&fields](const CSV::Fields &row) { fields += row.size(); });
+            if (fields == 0)
+            {
+                std::cerr << "no fields" << std::endl;
+            }
+        });
+    }
+
+    CSV::Summary summary;
+    std::vector<std::string> files = { option.file };
+    CSV::Settings settings;
+    stage("aggregrate fused", [&]()
+    {
+        summary = CSV::aggregrate(files, settings);
+    });
+
+    settings.useFloat = true;
+    stage("aggregrate fused --float", [&]()
+    {
+        summary = CSV::aggregrate(files, settings);
+    });
+    settings.useFloat = false;
+
+    settings.threads = option.threads;
+    stage("aggregrate fused -t" + std::to_string(option.threads), [&]()
+    {
+        summary = CSV::aggregrate(files, settings);
+    });
+
+    NullBuffer sink;
+    std::streambuf *old = std::cout.rdbuf();
+    const std::vector<CSV::Measure> sum = { CSV::MEASURE_SUM };
+    stage("print", [&]()
+    {
+        std::cout.rdbuf(&sink);
+        CSV::print(summary.agg, CSV::ORDER_FIRST_SEEN, -1, sum);
+        std::cout.rdbuf(old);
+    });
+    stage("print --by total --top 100", [&]()
+    {
+        std::cout.rdbuf(&sink);
+        CSV::print(summary.agg, CSV::ORDER_TOTAL, 100, sum);
+        std::cout.rdbuf(old);
+    });
+    std::cout << summary.agg.size() << " categories" << std::endl;
+
+    if (!option.keep)
+    {
+        std::remove(option.file.c_str());
+    }
+
+    return 0;
+}
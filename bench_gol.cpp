@@ -0,0 +1,386 @@
+/*****************************************************************************
+
+    Benchmark: every Game of Life engine in the repo on the same boards.
+
+    Each engine file is compiled into its own namespace with GOL_BENCH set,
+    which drops its main(). An Engine adapter per implementation loads a
+    fixed-seed board and advances it, so any engine plugs into the same
+    timing loop.
+
+    Usage:
+        bench_gol [-s 64,256,1024,4096,16384] [-d 0.1,0.3,0.5] [-n steps]
+                  [-e engine,...] [-b budget] [-S seed]
+
+    -n 0 (default) picks the steps per board so one case costs about
+    budget cell updates. Output is one line per engine and case with
+    ns/generation and cells/second; the final population is compared
+    across engines and a '!' marks an engine that disagrees.
+
+*****************************************************************************/
+
+// everything the engine files include, so their own #includes are no-ops
+// inside the namespaces below
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// outside the namespaces, so there is one stats registry
+#include "stats.h"
+#ifdef WITH_CUDA
+#include "gol_cuda.h"
+#endif
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+#define GOL_BENCH
+
+namespace gol {
+#include "gol.cpp"
+}
+
+namespace gol_claude {
+#include "gol_claude.cpp"
+}
+
+namespace gol_chatgpt {
+#include "gol_chatgpt.cpp"
+}
+
+struct Option {
+    Option() :
+        sizes("64,256,1024,4096,16384"),
+        densities("0.1,0.3,0.5"),
+        steps(0),
+        engines(""),
+        budget(200000000),
+        seed(1)
+    {
+    };
+
+    void get(int argc, char *argv[])
+    {
+        int c;
+        while (1)
+        {
+            static struct option longOpt[] = {
+                { "sizes", required_argument, 0, 's'},
+                { "densities", required_argument, 0, 'd'},
+                { "steps", required_argument, 0, 'n'},
+                { "engines", required_argument, 0, 'e'},
+                { "budget", required_argument, 0, 'b'},
+                { "seed", required_argument, 0, 'S'},
+                { 0, 0, 0, 0 }
+            };
+
+            int index = 0;
+
+            c = getopt_long(argc, argv, "s:d:n:e:b:S:", longOpt, &index);
+            if (c == -1)
+                break;
+
+            switch (c)
+            {
+            case 's':
+                sizes = optarg;
+                break;
+            case 'd':
+                densities = optarg;
+                break;
+            case 'n':
+                steps = std::atoi(optarg);
+                break;
+            case 'e':
+                engines = optarg;
+                break;
+            case 'b':
+                budget = std::atof(optarg);
+                break;
+            case 'S':
+                seed = std::atoll(optarg);
+                break;
+            default:
+                std::cerr << "Unknown option" << std::endl;
+                break;
+            }
+        }
+    }
+
+    std::string sizes;
+    std::string densities;
+    int steps;
+    std::string engines;    // empty runs all
+    double budget;          // cell updates per case when steps is 0
+    long long seed;
+};
+
+static std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    size_t begin = 0;
+    while (begin < list.length())
+    {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos)
+        {
+            end = list.length();
+        }
+        if (end > begin)
+        {
+            items.push_back(list.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return items;
+}
+
+/* what the harness needs from an engine */
+class Engine
+{
+public :
+    virtual ~Engine()
+    {
+    }
+
+    // square or not, cell (i, j) is alive iff cells[i*cols+j]
+    virtual void load(int rows, int cols, const std::vector<uint8_t> &cells) = 0;
+    virtual void advance(int generations) = 0;
+    virtual long population() const = 0;
+};
+
+/* gol.cpp engines by factory name, threads > 1 steps row bands in parallel */
+class GolEngine : public Engine
+{
+public :
+    GolEngine(const std::string &name, int threads) :
+        _name(name),
+        _threads(threads)
+    {
+    }
+
+    void load(int rows, int cols, const std::vector<uint8_t> &cells) override
+    {
+        _life = gol::GameOfLife::create(_name);
+        _life->setThreads(_threads);
+        _life->setSeed(0);
+        _life->initBoard(rows, cols, 1, true, false);
+        _life->loadCells(cells.data());
+    }
+
+    void advance(int generations) override
+    {
+        _life->advance(generations);
+    }
+
+    long population() const override
+    {
+        return _life->population();
+    }
+
+private :
+    std::string _name;
+    int _threads;
+    std::unique_ptr<gol::GameOfLife> _life;
+};
+
+/* gol_claude.cpp, 64x64 tiles with dirty tracking */
+class TiledEngine : public Engine
+{
+public :
+    void load(int rows, int cols, const std::vector<uint8_t> &cells) override
+    {
+        _life = std::make_unique<gol_claude::GameOfLife>();
+        _life->initBoard(rows, cols, 1, true, false);
+        _life->loadCells(cells.data());
+    }
+
+    void advance(int generations) override
+    {
+        _life->advance(generations);
+    }
+
+    long population() const override
+    {
+        return _life->population();
+    }
+
+private :
+    std::unique_ptr<gol_claude::GameOfLife> _life;
+};
+
+/* gol_chatgpt.cpp, byte cells with the AVX2/NEON row kernel or scalar */
+class ByteEngine : public Engine
+{
+public :
+    ByteEngine(bool simd) :
+        _simd(simd)
+    {
+    }
+
+    void load(int rows, int cols, const std::vector<uint8_t> &cells) override
+    {
+        std::mt19937_64 rng(0);
+        _life = std::make_unique<gol_chatgpt::GameOfLife>();
+        _life->setSimd(_simd);
+        _life->init(rows, cols, true, false, rng);
+        _life->loadCells(cells.data());
+    }
+
+    void advance(int generations) override
+    {
+        for (int i = 0; i < generations; i++)
+        {
+            _life->step();
+        }
+    }
+
+    long population() const override
+    {
+        return _life->population();
+    }
+
+private :
+    bool _simd;
+    std::unique_ptr<gol_chatgpt::GameOfLife> _life;
+};
+
+struct Entry {
+    std::string name;
+    std::function<std::unique_ptr<Engine>()> make;
+};
+
+static std::vector<Entry> engines()
+{
+    std::vector<Entry> all;
+    all.push_back({ "gol/bool", []() { return std::make_unique<GolEngine>("bool", 1); } });
+    all.push_back({ "gol/packed", []() { return std::make_unique<GolEngine>("packed", 1); } });
+
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    if (cores > 1)
+    {
+        all.push_back({ "gol/packed-t" + std::to_string(cores),
+            [cores]() { return std::make_unique<GolEngine>("packed", cores); } });
+    }
+
+    all.push_back({ "gol/hashlife", []() { return std::make_unique<GolEngine>("hashlife", 1); } });
+#ifdef WITH_CUDA
+    all.push_back({ "gol/cuda", []() { return std::make_unique<GolEngine>("cuda", 1); } });
+#endif
+    all.push_back({ "gol_claude/tiled", []() { return std::make_unique<TiledEngine>(); } });
+    all.push_back({ "gol_chatgpt/simd", []() { return std::make_unique<ByteEngine>(true); } });
+    all.push_back({ "gol_chatgpt/scalar", []() { return std::make_unique<ByteEngine>(false); } });
+    return all;
+}
+
+int main(int argc, char *argv[])
+{
+    Option option;
+    option.get(argc, argv);
+
+    std::vector<Entry> selected;
+    const std::vector<std::string> wanted = split(option.engines);
+    for (auto &entry : engines())
+    {
+        if (wanted.empty() || std::find(wanted.begin(), wanted.end(), entry.name) != wanted.end())
+        {
+            selected.push_back(entry);
+        }
+    }
+    if (selected.empty())
+    {
+        std::cerr << "No engine matches " << option.engines << std::endl;
+        return 1;
+    }
+
+    std::cout << std::left << std::setw(20) << "engine" << std::right
+              << std::setw(7) << "size" << std::setw(9) << "density" << std::setw(8) << "steps"
+              << std::setw(16) << "ns/gen" << std::setw(14) << "Mcells/s"
+              << std::setw(14) << "population" << std::endl;
+
+    for (auto &sizeName : split(option.sizes))
+    {
+        const int size = std::atoi(sizeName.c_str());
+        if (size <= 0)
+        {
+            std::cerr << "Bad size " << sizeName << std::endl;
+            return 1;
+        }
+        const double cells = static_cast<double>(size) * size;
+
+        for (auto &densityName : split(option.densities))
+        {
+            const double density = std::atof(densityName.c_str());
+
+            // same board for every engine
+            std::vector<uint8_t> board(static_cast<size_t>(size) * size);
+            std::mt19937_64 gen(static_cast<uint64_t>(option.seed));
+            std::bernoulli_distribution alive(density);
+            for (auto &c : board)
+            {
+                c = alive(gen) ? 1 : 0;
+            }
+
+            const int steps = option.steps > 0 ? option.steps
+                : static_cast<int>(std::max(1.0, std::min(10000.0, option.budget / cells)));
+
+            long reference = -1;
+            for (auto &entry : selected)
+            {
+                std::unique_ptr<Engine> engine = entry.make();
+                engine->load(size, size, board);
+
+                const auto start = std::chrono::steady_clock::now();
+                engine->advance(steps);
+                const auto stop = std::chrono::steady_clock::now();
+
+                const double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+                const long population = engine->population();
+                if (reference < 0)
+                {
+                    reference = population;
+                }
+
+                std::cout << std::left << std::setw(20) << entry.name << std::right
+                          << std::setw(7) << size << std::setw(9) << density << std::setw(8) << steps
+                          << std::setw(16) << std::fixed << std::setprecision(0) << ns / steps
+                          << std::setw(14) << std::setprecision(1) << cells * steps / ns * 1e3
+                          << std::setw(14) << population << (population == reference ? "" : " !")
+                          << std::defaultfloat << std::setprecision(6) << std::endl;
+            }
+        }
+    }
+
+    return 0;
+}
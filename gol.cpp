@@ -4,26 +4,78 @@
 
     Input seed from file or random; steps –steps M, size –rows R –cols C
     Print each generation (or only final with –final-only).
+    --stats prints per-phase timings as JSON on stderr (build with STATS=1).
+    --batch N runs N random boards from seeds S, S+1, ... and prints one
+    summary line per board instead of frames.
+    --rule B36/S23 picks another outer-totalistic rule (default B3/S23, or
+    the rule of an RLE seed file).
+    --time-block K steps cache-sized tiles K generations at a time when only
+    the final board is printed (0 picks it from the board size, 1 is off).
+    --checkpoint-every N --checkpoint-file F saves the run every N
+    generations; --resume continues from F when it exists.
+    --engine cuda runs on the GPU when built with make CUDA=1.
+    --distributed splits the board over MPI ranks (make MPI=1, then
+    mpirun -n N gol --distributed ...) and prints the population of each
+    shown generation instead of frames. Its random board is drawn per
+    block, so it differs from the single-process board for the same seed.
 
 *****************************************************************************/
 
 #include <cstdint>
 #include <cstddef>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <functional>
 #include <getopt.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "stats.h"
+#ifdef WITH_CUDA
+#include "gol_cuda.h"
+#endif
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
 struct Option {
     Option() :
         steps(-1),
         rows(-1),
         cols(-1),
         final_only(false),
-        detect_cycle(false)
+        detect_cycle(false),
+        engine("bool"),
+        threads(1),
+        cycle_algo("set"),
+        output_format("text"),
+        seed(-1),
+        stats(false),
+        batch(0),
+        time_block(0),
+        checkpoint_every(0),
+        resume(false),
+        distributed(false)
     {
     };
 
@@ -40,12 +92,26 @@ struct Option {
                     { "cols", required_argument, 0, 'c'},
                     { "final-only", no_argument, 0, 'f'},
                     { "detect-cycle", no_argument, 0, 'd'},
+                    { "engine", required_argument, 0, 'e'},
+                    { "threads", required_argument, 0, 't'},
+                    { "cycle-algo", required_argument, 0, 'a'},
+                    { "output-format", required_argument, 0, 'o'},
+                    { "seed", required_argument, 0, 'S'},
+                    { "seed-file", required_argument, 0, 'i'},
+                    { "stats", no_argument, 0, 'x'},
+                    { "batch", required_argument, 0, 'b'},
+                    { "rule", required_argument, 0, 'R'},
+                    { "time-block", required_argument, 0, 'T'},
+                    { "checkpoint-every", required_argument, 0, 'C'},
+                    { "checkpoint-file", required_argument, 0, 'F'},
+                    { "resume", no_argument, 0, 'z'},
+                    { "distributed", no_argument, 0, 'D'},
                     { 0, 0, 0, 0 }
                 };
 
                 int index = 0;
 
-                c = getopt_long(argc, argv, "s:r:c:fd", longOpt, &index);
+                c = getopt_long(argc, argv, "s:r:c:fde:t:a:o:S:i:", longOpt, &index);
                 if (c == -1)
                     break;
 
@@ -69,6 +135,54 @@ struct Option {
                 case 'd':
                     detect_cycle = true;
                     break;
+                case 'e':
+                    engine = optarg;
+                    break;
+                case 't':
+                    threads = std::atoi(optarg);
+                    if (threads <= 0) std::cerr << "Threads <= 0" << std::endl;
+                    break;
+                case 'a':
+                    cycle_algo = optarg;
+                    detect_cycle = true;
+                    break;
+                case 'o':
+                    output_format = optarg;
+                    break;
+                case 'S':
+                    seed = std::atoll(optarg);
+                    if (seed < 0) std::cerr << "Seed < 0" << std::endl;
+                    break;
+                case 'i':
+                    seed_file = optarg;
+                    break;
+                case 'x':
+                    stats = true;
+                    break;
+                case 'b':
+                    batch = std::atol(optarg);
+                    if (batch <= 0) std::cerr << "Batch <= 0" << std::endl;
+                    break;
+                case 'R':
+                    rule = optarg;
+                    break;
+                case 'T':
+                    time_block = std::atoi(optarg);
+                    if (time_block < 0) std::cerr << "Time block < 0" << std::endl;
+                    break;
+                case 'C':
+                    checkpoint_every = std::atoi(optarg);
+                    if (checkpoint_every < 0) std::cerr << "Checkpoint every < 0" << std::endl;
+                    break;
+                case 'F':
+                    checkpoint_file = optarg;
+                    break;
+                case 'z':
+                    resume = true;
+                    break;
+                case 'D':
+                    distributed = true;
+                    break;
                 default:
                     std::cerr << "Unknown option" << std::endl;
                     break;
@@ -77,14 +191,27 @@ struct Option {
         }
     }
 
-    void print()
+    void print(std::ostream &os)
     {
-        std::cout << "Options   " << std::endl;
-        std::cout << "steps      : " << steps << std::endl;
-        std::cout << "rows       : " << rows << std::endl;
-        std::cout << "cols       : " << cols << std::endl;
-        std::cout << "final only : " << (final_only ? "true" : "false") << std::endl;
-        std::cout << "detect cyc : " << (detect_cycle ? "true" : "false") << std::endl;
+        os << "Options   " << std::endl;
+        os << "steps      : " << steps << std::endl;
+        os << "rows       : " << rows << std::endl;
+        os << "cols       : " << cols << std::endl;
+        os << "final only : " << (final_only ? "true" : "false") << std::endl;
+        os << "detect cyc : " << (detect_cycle ? "true" : "false") << std::endl;
+        os << "engine     : " << engine << std::endl;
+        os << "threads    : " << threads << std::endl;
+        os << "cycle algo : " << cycle_algo << std::endl;
+        os << "output     : " << output_format << std::endl;
+        os << "seed       : " << seed << std::endl;
+        os << "seed file  : " << seed_file << std::endl;
+        os << "stats      : " << (stats ? "true" : "false") << std::endl;
+        os << "batch      : " << batch << std::endl;
+        os << "rule       : " << rule << std::endl;
+        os << "time block : " << time_block << std::endl;
+        os << "checkpoint : " << checkpoint_file << " every " << checkpoint_every << std::endl;
+        os << "resume     : " << (resume ? "true" : "false") << std::endl;
+        os << "distributed: " << (distributed ? "true" : "false") << std::endl;
     }
 
     int steps;
@@ -92,220 +219,3581 @@ struct Option {
     int cols;
     bool final_only;
     bool detect_cycle;
+    std::string engine;
+    int threads;
+    std::string cycle_algo;
+    std::string output_format;
+    long long seed;
+    std::string seed_file;
+    bool stats;             // phase timings as JSON on stderr
+    long batch;             // independent boards, 0 runs a single one
+    std::string rule;       // B/S notation, empty takes the seed file's or B3/S23
+    int time_block;         // generations per cache tile with --final-only, 0 is auto
+    int checkpoint_every;   // generations between checkpoints, 0 never
+    std::string checkpoint_file;
+    bool resume;            // continue from checkpoint_file when it exists
+    bool distributed;       // one block of the board per MPI rank
 };
 
-/* currently random board */
-class GameOfLife
+/*
+    Persistent workers for row-band stepping. Each worker owns one band and
+    sleeps until run() publishes a new generation, so the only
+    synchronisation is one wake-up and one join per generation.
+*/
+class BandPool
 {
 public :
-    GameOfLife() :
-        _row(1),
-        _col(1),
-        _steps(1),
-        _finalOnly(false),
-        _detectCycle(false),
-        _cell(nullptr),
-        _nextCycle(nullptr)
+    explicit BandPool(int bands) :
+        _bands(bands),
+        _generation(0),
+        _pending(0),
+        _stop(false),
+        _job(nullptr)
     {
+        // band 0 runs on the calling thread
+        for (int b = 1; b < _bands; b++)
+        {
+            _workers.emplace_back(&BandPool::worker, this, b);
+        }
     }
 
-    virtual ~GameOfLife()
+    ~BandPool()
     {
-        for (int i = 0; i < _row; i++)
         {
-            delete [] _cell[i];
-            delete [] _nextCycle[i];
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto &t : _workers)
+        {
+            t.join();
         }
-        delete [] _cell;
-        delete [] _nextCycle;
     }
 
-    void initBoard(int row, int col, int steps, bool finalOnly, bool detectCycle)
+    int bands() const
+    {
+        return _bands;
+    }
+
+    // call job(band) for every band and return once all of them finished
+    void run(const std::function<void(int)> &job)
     {
-        if (row <= 0 || col <= 0 || steps <= 0)
         {
-            throw std::invalid_argument("Row, col, and steps must be positive");
+            std::lock_guard<std::mutex> lock(_mutex);
+            _job = &job;
+            _pending = _bands - 1;
+            ++_generation;
         }
+        _wake.notify_all();
 
-        _row = row;
-        _col = col;
-        _steps = steps;
-        _finalOnly = finalOnly;
-        _detectCycle = detectCycle;
+        job(0);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this] { return _pending == 0; });
+        _job = nullptr;
+    }
 
-        _cell = new bool*[row];
-        _nextCycle = new bool*[row];
-        for (int i = 0; i < row; i++)
+private :
+    void worker(int band)
+    {
+        uint64_t seen = 0;
+        while (1)
         {
-            _cell[i] = new bool[col];
-            _nextCycle[i] = new bool[col];
-        }
+            const std::function<void(int)> *job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [this, seen] { return _stop || _generation != seen; });
+                if (_stop)
+                    return;
+                seen = _generation;
+                job = _job;
+            }
 
-        _neighborOffset = {
-            { -1, -1 }, {  0, -1 }, { 1, -1 },
-            { -1,  0 },             { 1,  0 },
-            { -1,  1 }, {  0,  1 }, { 1,  1 }
-        };
+            (*job)(band);
 
-        // randomize the board
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> distrib(0, 1);
-        for (int i = 0; i < _row; i++)
-        {
-            for (int j = 0; j < _col; j++)
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_pending == 0)
             {
-                _cell[i][j] = distrib(gen) == 1;
+                _done.notify_one();
             }
         }
+    }
 
-        if (detectCycle)
+    int _bands;
+    uint64_t _generation;
+    int _pending;
+    bool _stop;
+    const std::function<void(int)> *_job;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::vector<std::thread> _workers;
+};
+
+/*
+    Outer-totalistic rule in B/S notation: a dead cell with n live
+    neighbours is born when bit n of birth is set, a live one survives when
+    bit n of survive is set. Conway's Life is B3/S23.
+*/
+struct Rule {
+    Rule() :
+        birth(counts("3")),
+        survive(counts("23"))
+    {
+    }
+
+    // neighbour counts as a mask, "23" is bits 2 and 3
+    static constexpr uint16_t counts(const char *digits)
+    {
+        uint16_t mask = 0;
+        for (; *digits; ++digits)
         {
-            _history.reserve(60000);
+            mask |= static_cast<uint16_t>(1u << (*digits - '0'));
         }
+        return mask;
     }
 
-    void step()
+    // "B3/S23", "b36s23" or the older S/B form "23/3"
+    static bool parse(const std::string &text, Rule &rule)
     {
-        // for each cell, life when nb = 3 || isLife && nb = 2
-        for (int i = 0; i < _row; i++)
+        std::string s;
+        for (char ch : text)
         {
-            for (int j = 0; j < _col; j++)
+            s += static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+        }
+
+        std::string born, kept;
+        if (!s.empty() && s[0] == 'B')
+        {
+            const size_t at = s.find('S');
+            if (at == std::string::npos)
             {
-                // get adjustent
-                int count = 0;
-                for (auto &n : _neighborOffset)
-                {
-                    int ni = i+n.first, nj = j+n.second;
+                return false;
+            }
+            born = s.substr(1, at - 1);
+            kept = s.substr(at + 1);
+            if (!born.empty() && born.back() == '/')
+            {
+                born.pop_back();
+            }
+        }
+        else
+        {
+            const size_t at = s.find('/');
+            if (at == std::string::npos)
+            {
+                return false;
+            }
+            kept = s.substr(0, at);
+            born = s.substr(at + 1);
+        }
 
-                    if (ni < 0) ni += _row;
-                    else if (ni >= _row) ni -= _row;
+        Rule parsed;
+        if (!mask(born, parsed.birth) || !mask(kept, parsed.survive))
+        {
+            return false;
+        }
+        rule = parsed;
+        return true;
+    }
 
-                    if (nj < 0) nj += _col;
-                    else if (nj >= _col) nj -= _col;
-                    
-                    count += (_cell[ni][nj] ? 1 : 0);
-                }
-                _nextCycle[i][j] = (count == 3) || (_cell[i][j] && count == 2);
-            }
+    std::string name() const
+    {
+        std::string s = "B";
+        for (int n = 0; n <= 8; n++)
+        {
+            if ((birth >> n) & 1) s += static_cast<char>('0' + n);
+        }
+        s += "/S";
+        for (int n = 0; n <= 8; n++)
+        {
+            if ((survive >> n) & 1) s += static_cast<char>('0' + n);
         }
+        return s;
     }
 
-    void display()
+    bool is(uint16_t b, uint16_t s) const
     {
-        for (int i = 0; i < _row; i++)
+        return birth == b && survive == s;
+    }
+
+    uint16_t birth;
+    uint16_t survive;
+
+private :
+    static bool mask(const std::string &digits, uint16_t &out)
+    {
+        out = 0;
+        for (char ch : digits)
         {
-            for (int j = 0; j < _col; j++)
+            if (ch < '0' || ch > '8')
             {
-                std::cout << (_cell[i][j] ? 'o' : '.');
+                return false;
             }
-            std::cout << std::endl;
+            out |= static_cast<uint16_t>(1u << (ch - '0'));
         }
-        std::cout << std::endl;
+        return true;
     }
+};
 
-    void start()
+/*
+    Bit-sliced kernels, 64 cells per word. lifeWord() adds the eight
+    neighbour words up to the ones column and hands the partial sums to the
+    rule type, which finishes only as much of the count as it needs.
+    FixedRule has the masks as template arguments so the unused counts
+    fold away; Conway keeps its shorter 2-or-3 circuit. TableRule walks
+    the nine counts of a rule known only at run time.
+*/
+static inline void add3(uint64_t a, uint64_t b, uint64_t c, uint64_t &sum, uint64_t &carry)
+{
+    const uint64_t u = a ^ b;
+    sum = u ^ c;
+    carry = (a & b) | (u & c);
+}
+
+// count planes b0..b3 from the ones column s0 and the four weight-2 carries
+static inline void countPlanes(uint64_t c1, uint64_t c_u, uint64_t c_d, uint64_t c_m,
+                               uint64_t &b1, uint64_t &b2, uint64_t &b3)
+{
+    uint64_t t0, t1;
+    add3(c_u, c_d, c_m, t0, t1);
+    b1 = t0 ^ c1;
+    const uint64_t u = t0 & c1;
+    b2 = t1 ^ u;
+    b3 = t1 & u;
+}
+
+// lanes whose count is n; 8 is the only count with b3 set
+static inline uint64_t countIs(int n, uint64_t b0, uint64_t b1, uint64_t b2, uint64_t b3)
+{
+    if (n == 8)
+    {
+        return b3;
+    }
+    return ((n & 1) ? b0 : ~b0) & ((n & 2) ? b1 : ~b1) & ((n & 4) ? b2 : ~b2) & ~b3;
+}
+
+template <uint16_t BIRTH, uint16_t SURVIVE>
+struct FixedRule {
+    inline uint64_t operator()(uint64_t s0, uint64_t c1, uint64_t c_u, uint64_t c_d, uint64_t c_m,
+                               uint64_t alive) const
+    {
+        uint64_t b1, b2, b3;
+        countPlanes(c1, c_u, c_d, c_m, b1, b2, b3);
+        return select(std::make_integer_sequence<int, 9>(), s0, b1, b2, b3, alive);
+    }
+
+private :
+    template <int... N>
+    static inline uint64_t select(std::integer_sequence<int, N...>, uint64_t b0, uint64_t b1,
+                                  uint64_t b2, uint64_t b3, uint64_t alive)
+    {
+        return (pick<N>(b0, b1, b2, b3, alive) | ...);
+    }
+
+    template <int N>
+    static inline uint64_t pick(uint64_t b0, uint64_t b1, uint64_t b2, uint64_t b3, uint64_t alive)
     {
-        // initial state
-        if (!_finalOnly)
+        constexpr bool born = (BIRTH >> N) & 1, kept = (SURVIVE >> N) & 1;
+        if constexpr (!born && !kept)
+        {
+            return 0;
+        }
+        else
         {
-            std::cout << "Cycle: 0" << std::endl;
-            display();
+            const uint64_t hit = countIs(N, b0, b1, b2, b3);
+            return (born && kept) ? hit : born ? (hit & ~alive) : (hit & alive);
         }
+    }
+};
+
+// B3/S23: count is 2 or 3 iff exactly one weight-2 carry is set
+template <>
+inline uint64_t FixedRule<Rule::counts("3"), Rule::counts("23")>::operator()(uint64_t s0, uint64_t c1,
+    uint64_t c_u, uint64_t c_d, uint64_t c_m, uint64_t alive) const
+{
+    uint64_t p, q;
+    add3(c_u, c_d, c_m, p, q);
+    const uint64_t twoOrThree = (p ^ c1) & ~q;
+    return twoOrThree & (s0 | alive);
+}
+
+struct TableRule {
+    explicit TableRule(const Rule &rule) :
+        birth(rule.birth),
+        survive(rule.survive)
+    {
+    }
 
-        for (int i = 0; i < _steps; i++)
+    inline uint64_t operator()(uint64_t s0, uint64_t c1, uint64_t c_u, uint64_t c_d, uint64_t c_m,
+                               uint64_t alive) const
+    {
+        uint64_t b1, b2, b3;
+        countPlanes(c1, c_u, c_d, c_m, b1, b2, b3);
+
+        uint64_t out = 0;
+        for (int n = 0; n <= 8; n++)
         {
-            // cycle detection
-            if (_detectCycle)
+            const uint64_t take = (((birth >> n) & 1) ? ~alive : 0) | (((survive >> n) & 1) ? alive : 0);
+            out |= countIs(n, s0, b1, b2, b3) & take;
+        }
+        return out;
+    }
+
+    uint16_t birth;
+    uint16_t survive;
+};
+
+// next state of 64 cells from the west/centre/east words of the rows above, at and below
+template <class R>
+static inline uint64_t lifeWord(const R &rule, uint64_t uw, uint64_t uc, uint64_t ue,
+                                uint64_t mw, uint64_t mc, uint64_t me,
+                                uint64_t dw, uint64_t dc, uint64_t de)
+{
+    uint64_t s_u, c_u, s_d, c_d, s0, c1;
+    add3(uw, uc, ue, s_u, c_u);
+    add3(dw, dc, de, s_d, c_d);
+    const uint64_t s_m = mw ^ me, c_m = mw & me;
+    add3(s_u, s_d, s_m, s0, c1);
+    return rule(s0, c1, c_u, c_d, c_m, mc);
+}
+
+// f(kernel rule): compile-time masks for the common rules, the table for the rest
+template <class F>
+static inline void withRule(const Rule &rule, F &&f)
+{
+    if (rule.is(Rule::counts("3"), Rule::counts("23")))
+        f(FixedRule<Rule::counts("3"), Rule::counts("23")>());                // Life
+    else if (rule.is(Rule::counts("36"), Rule::counts("23")))
+        f(FixedRule<Rule::counts("36"), Rule::counts("23")>());               // HighLife
+    else if (rule.is(Rule::counts("2"), Rule::counts("")))
+        f(FixedRule<Rule::counts("2"), Rule::counts("")>());                  // Seeds
+    else if (rule.is(Rule::counts("3678"), Rule::counts("34678")))
+        f(FixedRule<Rule::counts("3678"), Rule::counts("34678")>());          // Day & Night
+    else
+        f(TableRule(rule));
+}
+
+/*
+    Output for whole generations, one write(2) per frame from a buffer that
+    is reused between frames.
+
+    text   "Cycle: N" and 'o'/'.' rows, the engine renders into body()
+    rle    "#CXRLE Gen=N", "x = C, y = R, rule = B3/S23" (the --rule in use)
+           and standard Life RLE ending with '!'
+    bits   binary header, then the board bit-packed row by row, each row
+           padded to whole 64-bit words (bit j of word k is column 64k+j)
+    delta  binary header, then a uint64 count and count pairs of uint64
+           (word index, word XOR previous frame); the first frame is
+           relative to an empty board
+
+    The binary header is 24 bytes: "GOLB" (bits) or "GOLD" (delta),
+    uint32 rows, uint32 cols, uint32 words per row, uint64 generation. All
+    binary integers are little-endian.
+*/
+class FrameWriter
+{
+public :
+    enum Format {
+        TEXT,
+        RLE,
+        BITS,
+        DELTA
+    };
+
+    explicit FrameWriter(int fd = STDOUT_FILENO) :
+        _fd(fd),
+        _format(TEXT),
+        _rule("B3/S23"),
+        _row(0),
+        _col(0),
+        _bodySize(0)
+    {
+    }
+
+    static bool parseFormat(const std::string &name, Format &format)
+    {
+        if (name == "text") format = TEXT;
+        else if (name == "rle") format = RLE;
+        else if (name == "bits") format = BITS;
+        else if (name == "delta") format = DELTA;
+        else return false;
+        return true;
+    }
+
+    void setFormat(Format format)
+    {
+        _format = format;
+    }
+
+    // rule named in the RLE header
+    void setRule(const Rule &rule)
+    {
+        _rule = rule.name();
+    }
+
+    Format format() const
+    {
+        return _format;
+    }
+
+    // size the buffers for row x col boards
+    void reset(int row, int col)
+    {
+        _row = row;
+        _col = col;
+        if (_format == TEXT)
+        {
+            // one '\n' per row and a trailing blank line
+            _bodySize = static_cast<size_t>(row) * (static_cast<size_t>(col) + 1) + 1;
+            _buffer.resize(HEADER + _bodySize);
+            _buffer.back() = '\n';
+        }
+        else if (_format == DELTA)
+        {
+            _prev.assign(static_cast<size_t>(row) * ((col + 63) / 64), 0);
+        }
+    }
+
+    // text only: rows are rendered here before write(generation)
+    char *body()
+    {
+        return _buffer.data() + HEADER;
+    }
+
+    void write(long generation)
+    {
+        // header is written right-aligned into the space before the body
+        char header[HEADER];
+        const int len = std::snprintf(header, sizeof(header), "Cycle: %ld\n", generation);
+        char *begin = body() - len;
+        std::memcpy(begin, header, len);
+        put(begin, _bodySize + len);
+    }
+
+    // rle/bits/delta: encode a bit-packed board
+    void write(long generation, const std::vector<uint64_t> &board)
+    {
+        _buffer.clear();
+        if (_format == RLE)
+        {
+            encodeRle(generation, board);
+        }
+        else if (_format == BITS)
+        {
+            putHeader("GOLB", generation);
+            for (uint64_t w : board)
             {
-                size_t s = hashState();
-                if (_history.find(s) != _history.end())
+                put64(w);
+            }
+        }
+        else
+        {
+            putHeader("GOLD", generation);
+            const size_t countAt = _buffer.size();
+            put64(0);
+
+            uint64_t count = 0;
+            for (size_t k = 0; k < board.size(); k++)
+            {
+                const uint64_t diff = board[k] ^ _prev[k];
+                if (diff)
                 {
-                    std::cout << "Cycle detected. Stop calculating." << std::endl;
-                    break;
+                    put64(k);
+                    put64(diff);
+                    ++count;
                 }
-                _history.insert(s);
             }
-
-            step();
-            update();
-            if (!_finalOnly || i == (_steps - 1))
+            for (int b = 0; b < 8; b++)
             {
-                std::cout << "Cycle: " << (i+1) << std::endl;
-                display();
+                _buffer[countAt + b] = static_cast<char>(count >> (8 * b));
             }
+            _prev = board;
         }
+        put(_buffer.data(), _buffer.size());
     }
 
 private :
-    void update()
+    static const int HEADER = 32;
+
+    void put32(uint32_t v)
     {
-        bool **temp = _cell;
-        _cell = _nextCycle;
-        _nextCycle = temp;
+        for (int b = 0; b < 4; b++)
+        {
+            _buffer.push_back(static_cast<char>(v >> (8 * b)));
+        }
     }
 
-    static inline uint64_t splitmix64(uint64_t x)
+    void put64(uint64_t v)
     {
-        x += 0x9e3779b97f4a7c15ull;
-        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
-        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
-        return x ^ (x >> 31);
+        for (int b = 0; b < 8; b++)
+        {
+            _buffer.push_back(static_cast<char>(v >> (8 * b)));
+        }
     }
 
-    static inline void hash_combine(uint64_t& h, uint64_t k)
+    void putHeader(const char magic[4], long generation)
     {
-        // similar spirit to boost::hash_combine
-        k = splitmix64(k);
-        h ^= k + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        _buffer.insert(_buffer.end(), magic, magic + 4);
+        put32(static_cast<uint32_t>(_row));
+        put32(static_cast<uint32_t>(_col));
+        put32(static_cast<uint32_t>((_col + 63) / 64));
+        put64(static_cast<uint64_t>(generation));
     }
 
-    size_t hashState()
+    void putText(const char *s, size_t n)
     {
-        uint64_t h = 0x243f6a8885a308d3ull;
-        hash_combine(h, (uint64_t)_row);
-        hash_combine(h, (uint64_t)_col);
+        _buffer.insert(_buffer.end(), s, s + n);
+    }
 
-        uint64_t word = 0;
-        int bitpos = 0;
+    // one RLE token "<count><tag>", wrapped to keep lines within 70 chars
+    void putRun(long count, char tag, size_t &lineStart)
+    {
+        char token[24];
+        int len = 0;
+        if (count > 1)
+        {
+            len = std::snprintf(token, sizeof(token), "%ld", count);
+        }
+        token[len++] = tag;
 
-        for (int i = 0; i < _row; ++i) {
-            for (int j = 0; j < _col; ++j) {
-                if (_cell[i][j]) word |= (uint64_t)1 << bitpos;
-                ++bitpos;
-                if (bitpos == 64)
+        if (_buffer.size() - lineStart + len > 70)
+        {
+            _buffer.push_back('\n');
+            lineStart = _buffer.size();
+        }
+        putText(token, len);
+    }
+
+    void encodeRle(long generation, const std::vector<uint64_t> &board)
+    {
+        char header[96];
+        const int len = std::snprintf(header, sizeof(header),
+            "#CXRLE Gen=%ld\nx = %d, y = %d, rule = %s\n", generation, _col, _row, _rule.c_str());
+        putText(header, len);
+
+        const int words = (_col + 63) / 64;
+        size_t lineStart = _buffer.size();
+        long pendingRows = 0;
+
+        for (int i = 0; i < _row; i++)
+        {
+            const uint64_t *r = board.data() + static_cast<size_t>(i) * words;
+            int j = 0;
+            while (j < _col)
+            {
+                const bool alive = (r[j >> 6] >> (j & 63)) & 1;
+                int k = j + 1;
+                while (k < _col && (((r[k >> 6] >> (k & 63)) & 1) != 0) == alive)
                 {
-                    hash_combine(h, word);
-                    word = 0;
-                    bitpos = 0;
+                    k++;
+                }
+
+                // dead cells at the end of a row are implied
+                if (alive || k < _col)
+                {
+                    if (pendingRows)
+                    {
+                        putRun(pendingRows, '$', lineStart);
+                        pendingRows = 0;
+                    }
+                    putRun(k - j, alive ? 'o' : 'b', lineStart);
                 }
+                j = k;
             }
+            ++pendingRows;
+        }
+
+        putRun(1, '!', lineStart);
+        _buffer.push_back('\n');
+    }
+
+    void put(const char *ptr, size_t left)
+    {
+        STATS_ADD("bytes", left);
+
+        // pending iostream output goes first to keep the order on the fd
+        std::cout.flush();
+
+        while (left > 0)
+        {
+            const ssize_t n = ::write(_fd, ptr, left);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+            ptr += n;
+            left -= static_cast<size_t>(n);
         }
-        if (bitpos) hash_combine(h, word); // flush partial word
-        return (size_t)h;
     }
 
+    int _fd;
+    Format _format;
+    std::string _rule;
     int _row;
     int _col;
-    int _steps;
-    bool _finalOnly;
-    bool _detectCycle;
-
-    bool **_cell;
-    bool **_nextCycle;
-    std::vector<std::pair<int, int>> _neighborOffset;
-    std::unordered_set<size_t> _history;
+    size_t _bodySize;
+    std::vector<char> _buffer;
+    std::vector<uint64_t> _prev;
 };
 
-int main(int argc, char *argv[])
-{
-    Option option;
-    option.get(argc, argv);
-    option.print();
+/*
+    Seed pattern in Life RLE or plaintext (.cells) format. The file is
+    memory-mapped and decoded in place: open() scans it once for the size,
+    decode() reports every live cell to a callback, so nothing is copied no
+    matter how large the pattern is.
 
-    GameOfLife gol;
-    gol.initBoard(option.rows, option.cols, option.steps, option.final_only, option.detect_cycle);
-    gol.start();
+    RLE      '#' comment lines, "x = W, y = H[, rule = ...]", then runs of
+             b (dead), o (alive), $ (end of row), terminated by '!'
+    .cells   '!' comment lines, then one line per row of '.' (dead) and
+             'O' or '*' (alive); short rows are padded with dead cells
+*/
+class SeedFile
+{
+public :
+    SeedFile() :
+        _data(nullptr),
+        _size(0),
+        _body(nullptr),
+        _rle(false),
+        _width(0),
+        _height(0)
+    {
+    }
+
+    ~SeedFile()
+    {
+        if (_data)
+        {
+            munmap(const_cast<char*>(_data), _size);
+        }
+    }
+
+    SeedFile(const SeedFile&) = delete;
+    SeedFile &operator=(const SeedFile&) = delete;
+
+    void open(const std::string &filename)
+    {
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Fail open seed file " + filename);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Empty seed file " + filename);
+        }
+
+        _size = static_cast<size_t>(st.st_size);
+        void *p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            throw std::runtime_error("Fail map seed file " + filename);
+        }
+        _data = static_cast<const char*>(p);
+        madvise(p, _size, MADV_SEQUENTIAL);
+
+        scan();
+    }
+
+    int width() const
+    {
+        return _width;
+    }
+
+    int height() const
+    {
+        return _height;
+    }
+
+    // "rule = ..." of an RLE header, empty when there is none
+    const std::string &rule() const
+    {
+        return _rule;
+    }
+
+    // call alive(row, col) for every live cell of the pattern
+    template <typename F>
+    void decode(F alive) const
+    {
+        const char *ptr = _body, *end = _data + _size;
+        if (_rle)
+        {
+            long count = 0;
+            int y = 0, x = 0;
+            for (; ptr < end && *ptr != '!'; ++ptr)
+            {
+                const char ch = *ptr;
+                if (ch >= '0' && ch <= '9')
+                {
+                    count = count * 10 + (ch - '0');
+                    continue;
+                }
+
+                const long n = count ? count : 1;
+                count = 0;
+                if (ch == '$')
+                {
+                    y += static_cast<int>(n);
+                    x = 0;
+                }
+                else if (ch == 'b' || ch == '.')
+                {
+                    x += static_cast<int>(n);
+                }
+                else if (std::isalpha(static_cast<unsigned char>(ch)))
+                {
+                    if (y >= _height || x + n > _width)
+                    {
+                        throw std::runtime_error("RLE pattern exceeds its x/y size");
+                    }
+                    for (long k = 0; k < n; k++)
+                    {
+                        alive(y, x++);
+                    }
+                }
+            }
+            return;
+        }
+
+        int y = 0, x = 0;
+        bool comment = false;
+        for (; ptr < end; ++ptr)
+        {
+            const char ch = *ptr;
+            if (ch == '\n')
+            {
+                if (!comment)
+                    ++y;
+                comment = false;
+                x = 0;
+            }
+            else if (x == 0 && ch == '!')
+            {
+                comment = true;
+            }
+            else if (!comment && ch != '\r')
+            {
+                if (ch == 'O' || ch == '*')
+                    alive(y, x);
+                ++x;
+            }
+        }
+    }
+
+private :
+    // find the format, the body and the pattern size
+    void scan()
+    {
+        const char *ptr = _data, *end = _data + _size;
+
+        // RLE when the first line that is not a '#' comment is the x = header
+        const char *line = ptr;
+        while (line < end && *line == '#')
+        {
+            line = nextLine(line, end);
+        }
+        if (line < end && *line == 'x')
+        {
+            _rle = true;
+            _body = nextLine(line, end);
+
+            char header[256];
+            const size_t len = std::min<size_t>(_body - line, sizeof(header) - 1);
+            std::memcpy(header, line, len);
+            header[len] = '\0';
+            if (std::sscanf(header, "x = %d , y = %d", &_width, &_height) != 2 || _width <= 0 || _height <= 0)
+            {
+                throw std::runtime_error("Bad RLE header");
+            }
+
+            char rule[64];
+            const char *at = std::strstr(header, "rule");
+            // Golly's bounded-grid suffix ("B3/S23:T100,100") is not part of the rule
+            if (at && std::sscanf(at, "rule = %63[^ \t\r\n,:]", rule) == 1)
+            {
+                _rule = rule;
+            }
+            return;
+        }
+
+        _body = ptr;
+        int x = 0;
+        bool comment = false;
+        for (; ptr < end; ++ptr)
+        {
+            if (*ptr == '\n')
+            {
+                if (!comment)
+                    ++_height;
+                comment = false;
+                x = 0;
+            }
+            else if (x == 0 && *ptr == '!')
+            {
+                comment = true;
+            }
+            else if (!comment && *ptr != '\r')
+            {
+                _width = std::max(_width, ++x);
+            }
+        }
+        if (x > 0 && !comment)
+        {
+            ++_height;
+        }
+        if (_width == 0 || _height == 0)
+        {
+            throw std::runtime_error("Empty seed pattern");
+        }
+    }
+
+    static const char *nextLine(const char *ptr, const char *end)
+    {
+        const void *nl = std::memchr(ptr, '\n', end - ptr);
+        return nl ? static_cast<const char*>(nl) + 1 : end;
+    }
+
+    const char *_data;
+    size_t _size;
+    const char *_body;
+    bool _rle;
+    int _width;
+    int _height;
+    std::string _rule;
+};
+
+/*
+    Checkpoint of a run: the board, the generation and the cycle detection
+    state. Everything is a little-endian uint64 so the file is used straight
+    from an mmap, and the board starts on a 64-byte boundary.
+
+    header  8 words: "GOLC" + uint32 version, uint32 rows + uint32 cols,
+            uint32 words per row + uint16 birth + uint16 survive, int64
+            generation, uint32 flags + int32 Brent power, int32 Brent
+            distance + uint32 0, uint64 history count or tortoise hash,
+            uint64 checksum of everything else
+    board   rows * words, the Snapshot layout
+    then    set detection: the history hashes
+            Brent: the seed board and the tortoise board
+
+    write() goes through a temporary, fsync() and rename(), then syncs the
+    directory, so a crash leaves either the previous checkpoint or the new
+    one.
+*/
+class Checkpoint
+{
+public :
+    enum Flags {
+        DETECT = 1,     // cycle detection was on
+        BRENT = 2       // ... with Brent's algorithm rather than the set
+    };
+
+    static constexpr int HEADER = 8;
+
+    Checkpoint() :
+        _data(nullptr),
+        _size(0)
+    {
+    }
+
+    ~Checkpoint()
+    {
+        if (_data)
+        {
+            munmap(const_cast<uint64_t*>(_data), _size);
+        }
+    }
+
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint &operator=(const Checkpoint&) = delete;
+
+    // FNV-style mix of the words, header checksum word excluded
+    static uint64_t checksum(const uint64_t *words, size_t count)
+    {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (size_t k = 0; k < count; k++)
+        {
+            if (k == HEADER - 1)
+                continue;
+            h = (h ^ words[k]) * 0x100000001b3ull;
+            h ^= h >> 29;
+        }
+        return h;
+    }
+
+    // words is header and body, the checksum is filled in here
+    static void write(const std::string &path, std::vector<uint64_t> &words)
+    {
+        words[HEADER - 1] = checksum(words.data(), words.size());
+
+        const std::string temp = path + ".tmp";
+        const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Fail open checkpoint " + temp);
+        }
+
+        const char *ptr = reinterpret_cast<const char*>(words.data());
+        size_t left = words.size() * sizeof(uint64_t);
+        while (left > 0)
+        {
+            const ssize_t n = ::write(fd, ptr, left);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+            {
+                ::close(fd);
+                ::unlink(temp.c_str());
+                throw std::runtime_error("Fail write checkpoint " + temp);
+            }
+            ptr += n;
+            left -= static_cast<size_t>(n);
+        }
+
+        const bool synced = fsync(fd) == 0;
+        if (::close(fd) != 0 || !synced || std::rename(temp.c_str(), path.c_str()) != 0)
+        {
+            ::unlink(temp.c_str());
+            throw std::runtime_error("Fail commit checkpoint " + path);
+        }
+
+        // the rename itself is only durable once the directory is synced
+        const size_t slash = path.find_last_of('/');
+        const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        const int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dirFd < 0)
+        {
+            throw std::runtime_error("Fail open checkpoint directory " + dir);
+        }
+        const bool dirSynced = fsync(dirFd) == 0;
+        ::close(dirFd);
+        if (!dirSynced)
+        {
+            throw std::runtime_error("Fail sync checkpoint directory " + dir);
+        }
+    }
+
+    void open(const std::string &path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Fail open checkpoint " + path);
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(HEADER * sizeof(uint64_t))
+            || st.st_size % sizeof(uint64_t) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Bad checkpoint size " + path);
+        }
+
+        _size = static_cast<size_t>(st.st_size);
+        void *p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            throw std::runtime_error("Fail map checkpoint " + path);
+        }
+        _data = static_cast<const uint64_t*>(p);
+
+        uint32_t magic;
+        std::memcpy(&magic, _data, sizeof(magic));
+        if (std::memcmp(&magic, "GOLC", 4) != 0 || half(0, 1) != VERSION)
+        {
+            throw std::runtime_error("Not a checkpoint of this version " + path);
+        }
+
+        const size_t count = _size / sizeof(uint64_t);
+        const size_t board = static_cast<size_t>(rows()) * words();
+        size_t expect = HEADER + board;
+        if (flags() & BRENT) expect += 2 * board;
+        else if (flags() & DETECT) expect += _data[6];
+        if (rows() <= 0 || cols() <= 0 || words() != (cols() + 63) / 64 || count != expect
+            || checksum(_data, count) != _data[HEADER - 1])
+        {
+            throw std::runtime_error("Corrupt checkpoint " + path);
+        }
+    }
+
+    int rows() const { return static_cast<int>(half(1, 0)); }
+    int cols() const { return static_cast<int>(half(1, 1)); }
+    int words() const { return static_cast<int>(half(2, 0)); }
+    uint16_t birth() const { return static_cast<uint16_t>(half(2, 1)); }
+    uint16_t survive() const { return static_cast<uint16_t>(half(2, 1) >> 16); }
+    long generation() const { return static_cast<long>(_data[3]); }
+    uint32_t flags() const { return half(4, 0); }
+    int power() const { return static_cast<int>(half(4, 1)); }
+    int lam() const { return static_cast<int>(half(5, 0)); }
+    uint64_t extra() const { return _data[6]; }
+
+    // rows * words per board; section 0 is the board, 1 and 2 the Brent boards
+    const uint64_t *board(int section = 0) const
+    {
+        return _data + HEADER + static_cast<size_t>(section) * rows() * words();
+    }
+
+    const uint64_t *history() const
+    {
+        return board(1);
+    }
+
+    static constexpr uint32_t VERSION = 1;
+
+private :
+    // low (0) or high (1) 32 bits of header word k
+    uint32_t half(int k, int which) const
+    {
+        return static_cast<uint32_t>(_data[k] >> (32 * which));
+    }
+
+    const uint64_t *_data;
+    size_t _size;
+};
+
+/* random board, or a seed pattern centred on it */
+class GameOfLife
+{
+public :
+    enum CycleAlgo {
+        CYCLE_SET,      // every hash in _history, memory grows per generation
+        CYCLE_BRENT     // Brent's algorithm on board snapshots, O(1) boards
+    };
+
+    GameOfLife() :
+        _row(1),
+        _col(1),
+        _steps(1),
+        _finalOnly(false),
+        _detectCycle(false),
+        _threads(1),
+        _cycleAlgo(CYCLE_SET),
+        _timeBlock(0),
+        _generation(0),
+        _checkpointEvery(0),
+        _resume(nullptr),
+        _tortoiseHash(0),
+        _power(1),
+        _lam(0),
+        _seed(-1),
+        _pattern(nullptr)
+    {
+    }
+
+    virtual ~GameOfLife()
+    {
+    }
+
+    // engine factory, returns nullptr for an unknown name
+    static std::unique_ptr<GameOfLife> create(const std::string &engine);
+
+    // word mixing of hashState(), public for DistLife's block hashes
+    static inline uint64_t splitmix64(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    static inline void hash_combine(uint64_t& h, uint64_t k)
+    {
+        // similar spirit to boost::hash_combine
+        k = splitmix64(k);
+        h ^= k + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    }
+
+    // number of row bands stepped in parallel, applied by initBoard()
+    void setThreads(int threads)
+    {
+        _threads = threads;
+    }
+
+    // cycle detection method used with detectCycle, applied by initBoard()
+    void setCycleAlgo(CycleAlgo algo)
+    {
+        _cycleAlgo = algo;
+    }
+
+    // fixed RNG seed for the random board, negative draws one from random_device
+    void setSeed(long long seed)
+    {
+        _seed = seed;
+    }
+
+    // pattern placed on an empty board instead of random cells
+    void setPattern(const SeedFile *pattern)
+    {
+        _pattern = pattern;
+    }
+
+    // frame format of display(), applied by initBoard()
+    void setOutputFormat(FrameWriter::Format format)
+    {
+        _frame.setFormat(format);
+    }
+
+    // write a checkpoint to path every `every` generations, 0 never
+    void setCheckpoint(const std::string &path, int every)
+    {
+        _checkpointFile = path;
+        _checkpointEvery = every;
+    }
+
+    // continue from a checkpoint instead of a new board, applied by initBoard()
+    void setResume(const Checkpoint *checkpoint)
+    {
+        _resume = checkpoint;
+    }
+
+    // generations per cache tile in advance(), 0 sizes it from the board, 1 turns tiling off
+    void setTimeBlock(int generations)
+    {
+        _timeBlock = generations;
+    }
+
+    // birth/survival rule, applied by initBoard()
+    void setRule(const Rule &rule)
+    {
+        _rule = rule;
+        _frame.setRule(rule);
+    }
+
+    // status lines go to stderr when stdout carries a frame stream
+    std::ostream &log() const
+    {
+        return _frame.format() == FrameWriter::TEXT ? std::cout : std::cerr;
+    }
+
+    void initBoard(int row, int col, int steps, bool finalOnly, bool detectCycle)
+    {
+        if (row <= 0 || col <= 0 || steps <= 0)
+        {
+            throw std::invalid_argument("Row, col, and steps must be positive");
+        }
+
+        _row = row;
+        _col = col;
+        _steps = steps;
+        _finalOnly = finalOnly;
+        _detectCycle = detectCycle;
+
+        allocate();
+        _frame.reset(_row, _col);
+        _generation = 0;
+
+        if (_resume)
+        {
+            restore(*_resume);
+        }
+        else if (_pattern)
+        {
+            if (_pattern->height() > _row || _pattern->width() > _col)
+            {
+                throw std::invalid_argument("Seed pattern is larger than the board");
+            }
+
+            // allocate() leaves the board empty
+            const int top = (_row - _pattern->height()) / 2;
+            const int left = (_col - _pattern->width()) / 2;
+            _pattern->decode([this, top, left](int i, int j) {
+                setCell(top + i, left + j, true);
+            });
+        }
+        else
+        {
+            // randomize the board
+            std::random_device rd;
+            std::mt19937 gen(_seed >= 0 ? static_cast<std::mt19937::result_type>(_seed) : rd());
+            std::uniform_int_distribution<> distrib(0, 1);
+            for (int i = 0; i < _row; i++)
+            {
+                for (int j = 0; j < _col; j++)
+                {
+                    setCell(i, j, distrib(gen) == 1);
+                }
+            }
+        }
+
+        if (_resume)
+        {
+            // restore() brought the detection state along
+        }
+        else if (detectCycle && _cycleAlgo == CYCLE_SET)
+        {
+            _history.reserve(std::min(_steps + 1, 60000));
+        }
+        else if (detectCycle)
+        {
+            // the seed is kept to replay up to the cycle start once a period is found
+            save(_origin);
+            _tortoise = _origin;
+            _tortoiseHash = timedHash();
+            _power = 1;
+            _lam = 0;
+        }
+
+        _pool.reset();
+        if (std::min(_threads, _row) > 1)
+        {
+            _pool = std::make_unique<BandPool>(std::min(_threads, _row));
+        }
+    }
+
+    // compute the next generation into the back buffer
+    void step()
+    {
+        STATS_TIMER("step");
+        if (!_pool)
+        {
+            stepRows(0, _row);
+            return;
+        }
+
+        // bands only read the front buffer and write their own rows of the back buffer
+        const int bands = _pool->bands();
+        _pool->run([this, bands](int band) {
+            stepRows(static_cast<int>(static_cast<long>(_row) * band / bands),
+                     static_cast<int>(static_cast<long>(_row) * (band + 1) / bands));
+        });
+    }
+
+    // replace the board after initBoard(), cell (i, j) is alive iff cells[i*col+j]
+    void loadCells(const uint8_t *cells)
+    {
+        for (int i = 0; i < _row; i++)
+        {
+            for (int j = 0; j < _col; j++)
+            {
+                setCell(i, j, cells[static_cast<size_t>(i) * _col + j] != 0);
+            }
+        }
+    }
+
+    // live cells on the board
+    long population() const
+    {
+        long count = 0;
+        for (int i = 0; i < _row; i++)
+        {
+            for (int j = 0; j < _col; j++)
+            {
+                count += cell(i, j) ? 1 : 0;
+            }
+        }
+        return count;
+    }
+
+    // advance several generations with nothing observed in between
+    virtual void advance(int generations)
+    {
+        for (int i = 0; i < generations; i++)
+        {
+            step();
+            update();
+        }
+    }
+
+    void display(long generation)
+    {
+        STATS_TIMER("display");
+        if (_frame.format() == FrameWriter::TEXT)
+        {
+            render(_frame.body());
+            _frame.write(generation);
+            return;
+        }
+
+        save(_shot);
+        _frame.write(generation, _shot);
+    }
+
+    void start()
+    {
+        // initial state, a resumed run already showed it
+        if (!_finalOnly && _generation == 0)
+        {
+            display(0);
+        }
+
+        // only the last board is printed, let the engine take the run in one go
+        if (_finalOnly && !_detectCycle)
+        {
+            for (int g = _generation; g < _steps; )
+            {
+                const int n = _checkpointEvery > 0 ? std::min(_checkpointEvery - g % _checkpointEvery, _steps - g)
+                                                   : _steps - g;
+                advance(n);
+                STATS_ADD("generations", n);
+                g += n;
+                if (_checkpointEvery > 0 && g % _checkpointEvery == 0)
+                {
+                    checkpoint(g);
+                }
+            }
+            display(_steps);
+            return;
+        }
+
+        for (int i = _generation; i < _steps; i++)
+        {
+            // cycle detection
+            if (_detectCycle && _cycleAlgo == CYCLE_SET)
+            {
+                size_t s = timedHash();
+                if (_history.find(s) != _history.end())
+                {
+                    log() << "Cycle detected. Stop calculating." << std::endl;
+                    break;
+                }
+                _history.insert(s);
+            }
+
+            step();
+            update();
+            STATS_ADD("generations", 1);
+            if (!_finalOnly || i == (_steps - 1))
+            {
+                display(i+1);
+            }
+
+            int period;
+            if (_detectCycle && _cycleAlgo == CYCLE_BRENT && brentStep(period))
+            {
+                log() << "Cycle detected: period " << period
+                          << ", entered at generation " << findCycleStart(period)
+                          << ". Stop calculating." << std::endl;
+                break;
+            }
+
+            if (_checkpointEvery > 0 && (i + 1) % _checkpointEvery == 0)
+            {
+                checkpoint(i + 1);
+            }
+        }
+
+        if (_detectCycle && _cycleAlgo == CYCLE_SET)
+        {
+            STATS_SET("history_size", _history.size());
+            STATS_SET("history_load_factor", _history.load_factor());
+        }
+    }
+
+protected :
+    // storage hooks implemented by each engine
+    virtual void stepRows(int begin, int end) = 0;
+    virtual void allocate() = 0;
+    virtual void update() = 0;
+    virtual bool cell(int i, int j) const = 0;
+    virtual void setCell(int i, int j, bool alive) = 0;
+
+    // write the board as 'o'/'.' rows, each ended by '\n'
+    virtual void render(char *out) const
+    {
+        for (int i = 0; i < _row; i++)
+        {
+            for (int j = 0; j < _col; j++)
+            {
+                *out++ = cell(i, j) ? 'o' : '.';
+            }
+            *out++ = '\n';
+        }
+    }
+
+    // bit-packed copy of the board, rows padded to whole 64-bit words
+    typedef std::vector<uint64_t> Snapshot;
+
+    virtual void save(Snapshot &s) const
+    {
+        const int words = (_col + 63) / 64;
+        s.assign(static_cast<size_t>(_row) * words, 0);
+        for (int i = 0; i < _row; i++)
+        {
+            for (int j = 0; j < _col; j++)
+            {
+                if (cell(i, j)) s[static_cast<size_t>(i) * words + (j >> 6)] |= 1ull << (j & 63);
+            }
+        }
+    }
+
+    virtual void load(const Snapshot &s)
+    {
+        const int words = (_col + 63) / 64;
+        for (int i = 0; i < _row; i++)
+        {
+            for (int j = 0; j < _col; j++)
+            {
+                setCell(i, j, (s[static_cast<size_t>(i) * words + (j >> 6)] >> (j & 63)) & 1);
+            }
+        }
+    }
+
+    // board and cycle detection state after `generation` generations, see Checkpoint
+    void checkpoint(int generation)
+    {
+        STATS_TIMER("checkpoint");
+        save(_shot);
+
+        const uint32_t flags = (_detectCycle ? Checkpoint::DETECT : 0)
+            | (_detectCycle && _cycleAlgo == CYCLE_BRENT ? Checkpoint::BRENT : 0);
+        const uint64_t extra = !_detectCycle ? 0
+            : _cycleAlgo == CYCLE_BRENT ? _tortoiseHash : _history.size();
+
+        std::vector<uint64_t> words(Checkpoint::HEADER, 0);
+        std::memcpy(&words[0], "GOLC", 4);
+        words[0] |= static_cast<uint64_t>(Checkpoint::VERSION) << 32;
+        words[1] = static_cast<uint32_t>(_row) | (static_cast<uint64_t>(_col) << 32);
+        words[2] = static_cast<uint32_t>((_col + 63) / 64)
+            | (static_cast<uint64_t>(_rule.birth | (static_cast<uint32_t>(_rule.survive) << 16)) << 32);
+        words[3] = static_cast<uint64_t>(generation);
+        words[4] = flags | (static_cast<uint64_t>(static_cast<uint32_t>(_power)) << 32);
+        words[5] = static_cast<uint32_t>(_lam);
+        words[6] = extra;
+
+        words.insert(words.end(), _shot.begin(), _shot.end());
+        if (flags & Checkpoint::BRENT)
+        {
+            words.insert(words.end(), _origin.begin(), _origin.end());
+            words.insert(words.end(), _tortoise.begin(), _tortoise.end());
+        }
+        else if (flags & Checkpoint::DETECT)
+        {
+            words.insert(words.end(), _history.begin(), _history.end());
+        }
+
+        Checkpoint::write(_checkpointFile, words);
+    }
+
+    // initBoard() with a checkpoint: its board, generation and detection state
+    void restore(const Checkpoint &c)
+    {
+        STATS_TIMER("resume");
+        if (c.rows() != _row || c.cols() != _col)
+        {
+            throw std::invalid_argument("Checkpoint board is " + std::to_string(c.rows()) + "x" + std::to_string(c.cols()));
+        }
+        if (!_rule.is(c.birth(), c.survive()))
+        {
+            throw std::invalid_argument("Checkpoint was written with another rule");
+        }
+        const uint32_t flags = (_detectCycle ? Checkpoint::DETECT : 0)
+            | (_detectCycle && _cycleAlgo == CYCLE_BRENT ? Checkpoint::BRENT : 0);
+        if (flags != c.flags())
+        {
+            throw std::invalid_argument("Checkpoint was written with other cycle detection settings");
+        }
+
+        const size_t board = static_cast<size_t>(c.rows()) * c.words();
+        _shot.assign(c.board(), c.board() + board);
+        load(_shot);
+        _generation = static_cast<int>(c.generation());
+
+        if (flags & Checkpoint::BRENT)
+        {
+            _origin.assign(c.board(1), c.board(1) + board);
+            _tortoise.assign(c.board(2), c.board(2) + board);
+            _tortoiseHash = c.extra();
+            _power = c.power();
+            _lam = c.lam();
+        }
+        else if (flags & Checkpoint::DETECT)
+        {
+            _history.clear();
+            _history.reserve(std::max<size_t>(c.extra(), std::min(_steps + 1, 60000)));
+            _history.insert(c.history(), c.history() + c.extra());
+        }
+    }
+
+    /*
+        Brent's algorithm, called once per generation. The tortoise is moved to
+        the current board whenever the distance reaches the next power of two,
+        so a repeat is found within two periods of entering the cycle. A hash
+        match is only a candidate, the snapshot comparison makes it exact.
+    */
+    bool brentStep(int &period)
+    {
+        ++_lam;
+        const size_t h = timedHash();
+        if (h == _tortoiseHash)
+        {
+            Snapshot now;
+            save(now);
+            if (now == _tortoise)
+            {
+                period = _lam;
+                return true;
+            }
+        }
+
+        if (_lam == _power)
+        {
+            save(_tortoise);
+            _tortoiseHash = h;
+            _power *= 2;
+            _lam = 0;
+        }
+        return false;
+    }
+
+    // first generation m with state(m) == state(m + period), replayed from the seed
+    int findCycleStart(int period)
+    {
+        Snapshot current, a = _origin, b;
+        save(current);
+
+        load(_origin);
+        for (int i = 0; i < period; i++)
+        {
+            step();
+            update();
+        }
+        save(b);
+
+        int start = 0;
+        while (a != b)
+        {
+            load(a);
+            step();
+            update();
+            save(a);
+
+            load(b);
+            step();
+            update();
+            save(b);
+
+            ++start;
+        }
+
+        load(current);
+        return start;
+    }
+
+    // hashState() under the "hash" timer
+    size_t timedHash()
+    {
+        STATS_TIMER("hash");
+        return hashState();
+    }
+
+    virtual size_t hashState()
+    {
+        uint64_t h = 0x243f6a8885a308d3ull;
+        hash_combine(h, (uint64_t)_row);
+        hash_combine(h, (uint64_t)_col);
+
+        uint64_t word = 0;
+        int bitpos = 0;
+
+        for (int i = 0; i < _row; ++i) {
+            for (int j = 0; j < _col; ++j) {
+                if (cell(i, j)) word |= (uint64_t)1 << bitpos;
+                ++bitpos;
+                if (bitpos == 64)
+                {
+                    hash_combine(h, word);
+                    word = 0;
+                    bitpos = 0;
+                }
+            }
+        }
+        if (bitpos) hash_combine(h, word); // flush partial word
+        return (size_t)h;
+    }
+
+    int _row;
+    int _col;
+    int _steps;
+    bool _finalOnly;
+    bool _detectCycle;
+    int _threads;
+    CycleAlgo _cycleAlgo;
+    int _timeBlock;
+    Rule _rule;
+
+    // first generation of this run, non-zero after a resume
+    int _generation;
+    std::string _checkpointFile;
+    int _checkpointEvery;
+    const Checkpoint *_resume;
+    FrameWriter _frame;
+    Snapshot _shot;
+
+    std::unordered_set<size_t> _history;
+
+    // Brent state: seed, tortoise board, distance from tortoise and its bound
+    Snapshot _origin;
+    Snapshot _tortoise;
+    size_t _tortoiseHash;
+    int _power;
+    int _lam;
+
+    long long _seed;
+    const SeedFile *_pattern;
+    std::unique_ptr<BandPool> _pool;
+};
+
+/*
+    One bool per cell, neighbours counted one by one. Both generations live
+    in one 64-byte aligned block with rows padded to whole cache lines, and
+    boards of a huge page or more are mmap()ed with MADV_HUGEPAGE to cut
+    TLB misses. A later initBoard() that fits reuses the block.
+*/
+class BoolLife : public GameOfLife
+{
+public :
+    BoolLife() :
+        _arena(nullptr),
+        _capacity(0),
+        _mapped(false),
+        _stride(0),
+        _cell(nullptr),
+        _nextCycle(nullptr)
+    {
+    }
+
+    virtual ~BoolLife()
+    {
+        release();
+    }
+
+protected :
+    void stepRows(int begin, int end) override
+    {
+        // for each cell, the rule table by state and neighbour count
+        for (int i = begin; i < end; i++)
+        {
+            const bool *up = row(_cell, i == 0 ? _row - 1 : i - 1);
+            const bool *mid = row(_cell, i);
+            const bool *down = row(_cell, i == _row - 1 ? 0 : i + 1);
+            bool *out = row(_nextCycle, i);
+
+            for (int j = 0; j < _col; j++)
+            {
+                // get adjustent
+                const int w = j == 0 ? _col - 1 : j - 1;
+                const int e = j == _col - 1 ? 0 : j + 1;
+                const int count = up[w] + up[j] + up[e] + mid[w] + mid[e] + down[w] + down[j] + down[e];
+                out[j] = _table[mid[j] ? 1 : 0][count];
+            }
+        }
+    }
+
+    void allocate() override
+    {
+        _stride = (static_cast<size_t>(_col) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+        const size_t bytes = 2 * _stride * _row;
+        if (bytes > _capacity)
+        {
+            release();
+            _capacity = bytes;
+            _arena = static_cast<bool*>(reserve(_capacity, _mapped));
+        }
+
+        // allocate() leaves the board empty
+        std::memset(_arena, 0, bytes);
+        _cell = _arena;
+        _nextCycle = _arena + _stride * _row;
+
+        for (int n = 0; n <= 8; n++)
+        {
+            _table[0][n] = (_rule.birth >> n) & 1;
+            _table[1][n] = (_rule.survive >> n) & 1;
+        }
+    }
+
+    void update() override
+    {
+        std::swap(_cell, _nextCycle);
+    }
+
+    bool cell(int i, int j) const override
+    {
+        return row(_cell, i)[j];
+    }
+
+    void setCell(int i, int j, bool alive) override
+    {
+        row(_cell, i)[j] = alive;
+    }
+
+private :
+    static constexpr size_t CACHE_LINE = 64;
+    static constexpr size_t HUGE_PAGE = 2 << 20;
+
+    bool *row(bool *grid, int i) const
+    {
+        return grid + static_cast<size_t>(i) * _stride;
+    }
+
+    const bool *row(const bool *grid, int i) const
+    {
+        return grid + static_cast<size_t>(i) * _stride;
+    }
+
+    /*
+        Cache-line aligned memory. From a huge page up, whole 2 MiB aligned
+        huge pages are mapped (bytes is rounded up to them): mmap() only
+        promises 4 KiB alignment, so one extra huge page is mapped and the
+        unaligned head and the tail are unmapped again.
+    */
+    static void *reserve(size_t &bytes, bool &mapped)
+    {
+        if (bytes >= HUGE_PAGE)
+        {
+            const size_t length = (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+            void *p = mmap(nullptr, length + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p != MAP_FAILED)
+            {
+                char *raw = static_cast<char*>(p);
+                char *base = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1));
+                if (base > raw)
+                {
+                    munmap(raw, base - raw);
+                }
+                munmap(base + length, raw + HUGE_PAGE - base);
+#ifdef MADV_HUGEPAGE
+                madvise(base, length, MADV_HUGEPAGE);
+#endif
+                bytes = length;
+                mapped = true;
+                return base;
+            }
+        }
+
+        void *p = nullptr;
+        if (posix_memalign(&p, CACHE_LINE, bytes) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        mapped = false;
+        return p;
+    }
+
+    void release()
+    {
+        if (_mapped)
+        {
+            munmap(_arena, _capacity);
+        }
+        else
+        {
+            std::free(_arena);
+        }
+        _arena = nullptr;
+        _capacity = 0;
+        _mapped = false;
+        _cell = nullptr;
+        _nextCycle = nullptr;
+    }
+
+    bool *_arena;           // both generations
+    size_t _capacity;
+    bool _mapped;           // from mmap() rather than posix_memalign()
+    size_t _stride;         // bools per row, _col rounded up to a cache line
+    bool *_cell;
+    bool *_nextCycle;
+    bool _table[2][9];      // next state by [alive][neighbours]
+};
+
+/*
+    64 cells per uint64_t, bit j of word k is column k*64+j. Unused bits of
+    the last word in a row are kept zero so rows can be hashed word by word.
+
+    step() builds the 8 neighbour planes by shifting whole words and adds
+    them with a bit-sliced adder, so every word computes 64 cells at once.
+*/
+class PackedLife : public GameOfLife
+{
+public :
+    PackedLife() :
+        _words(0),
+        _lastMask(~0ull)
+    {
+    }
+
+protected :
+    void stepRows(int begin, int end) override
+    {
+        withRule(_rule, [this, begin, end](const auto &rule) {
+            stepRowsWith(rule, begin, end);
+        });
+    }
+
+    void allocate() override
+    {
+        _words = (_col + 63) / 64;
+        _lastMask = (_col % 64) ? ((1ull << (_col % 64)) - 1) : ~0ull;
+        _cell.assign(static_cast<size_t>(_row) * _words, 0);
+        _next.assign(static_cast<size_t>(_row) * _words, 0);
+    }
+
+    void update() override
+    {
+        _cell.swap(_next);
+    }
+
+    // several generations per pass over the board once it is larger than the caches
+    void advance(int generations) override
+    {
+        const int block = timeBlock();
+        if (block <= 1)
+        {
+            GameOfLife::advance(generations);
+            return;
+        }
+
+        STATS_TIMER("advance");
+        while (generations > 0)
+        {
+            const int g = std::min(block, generations);
+            withRule(_rule, [this, g](const auto &rule) {
+                advanceBlocked(rule, g);
+            });
+            update();
+            generations -= g;
+        }
+    }
+
+    bool cell(int i, int j) const override
+    {
+        return (row(_cell, i)[j >> 6] >> (j & 63)) & 1;
+    }
+
+    void setCell(int i, int j, bool alive) override
+    {
+        uint64_t &w = row(_cell, i)[j >> 6];
+        const uint64_t bit = 1ull << (j & 63);
+        w = alive ? (w | bit) : (w & ~bit);
+    }
+
+    size_t hashState() override
+    {
+        uint64_t h = 0x243f6a8885a308d3ull;
+        hash_combine(h, (uint64_t)_row);
+        hash_combine(h, (uint64_t)_col);
+        for (uint64_t w : _cell)
+        {
+            hash_combine(h, w);
+        }
+        return (size_t)h;
+    }
+
+    void save(Snapshot &s) const override
+    {
+        s = _cell;
+    }
+
+    void render(char *out) const override
+    {
+        // 8 output chars per byte of a word
+        static const auto glyphs = [] {
+            std::vector<uint64_t> t(256);
+            for (int b = 0; b < 256; b++)
+            {
+                char chars[8];
+                for (int k = 0; k < 8; k++)
+                {
+                    chars[k] = ((b >> k) & 1) ? 'o' : '.';
+                }
+                std::memcpy(&t[b], chars, 8);
+            }
+            return t;
+        }();
+
+        for (int i = 0; i < _row; i++)
+        {
+            const uint64_t *r = row(_cell, i);
+            int j = 0;
+            for (; j + 8 <= _col; j += 8)
+            {
+                std::memcpy(out, &glyphs[(r[j >> 6] >> (j & 63)) & 0xff], 8);
+                out += 8;
+            }
+            for (; j < _col; j++)
+            {
+                *out++ = ((r[j >> 6] >> (j & 63)) & 1) ? 'o' : '.';
+            }
+            *out++ = '\n';
+        }
+    }
+
+    void load(const Snapshot &s) override
+    {
+        _cell = s;
+    }
+
+    void clearBoard()
+    {
+        std::fill(_cell.begin(), _cell.end(), 0);
+    }
+
+private :
+    template <class R>
+    void stepRowsWith(const R &rule, int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            stepRow(rule, row(_cell, i == 0 ? _row - 1 : i - 1), row(_cell, i),
+                    row(_cell, i == _row - 1 ? 0 : i + 1), row(_next, i));
+        }
+    }
+
+    // next generation of row mid into out
+    template <class R>
+    void stepRow(const R &rule, const uint64_t *up, const uint64_t *mid, const uint64_t *down,
+                 uint64_t *out) const
+    {
+        // the wrap-around only touches the first and last word of a row
+        out[0] = lifeWord(rule, west(up, 0), up[0], east(up, 0),
+                          west(mid, 0), mid[0], east(mid, 0),
+                          west(down, 0), down[0], east(down, 0));
+        for (int k = 1; k < _words - 1; k++)
+        {
+            out[k] = lifeWord(rule, westInner(up, k), up[k], eastInner(up, k),
+                              westInner(mid, k), mid[k], eastInner(mid, k),
+                              westInner(down, k), down[k], eastInner(down, k));
+        }
+        if (_words > 1)
+        {
+            const int k = _words - 1;
+            out[k] = lifeWord(rule, west(up, k), up[k], east(up, k),
+                              west(mid, k), mid[k], east(mid, k),
+                              west(down, k), down[k], east(down, k));
+        }
+        out[_words - 1] &= _lastMask;
+    }
+
+    // cache size from sysconf() where the libc reports it
+    static size_t cacheBytes(int level, size_t fallback)
+    {
+        long bytes = -1;
+#if defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL3_CACHE_SIZE)
+        bytes = sysconf(level == 2 ? _SC_LEVEL2_CACHE_SIZE : _SC_LEVEL3_CACHE_SIZE);
+#else
+        (void)level;
+#endif
+        return bytes > 0 ? static_cast<size_t>(bytes) : fallback;
+    }
+
+    // generations per tile: the set value, or TIME_BLOCK once both boards spill out of the last cache
+    int timeBlock() const
+    {
+        if (_timeBlock > 0)
+        {
+            return _timeBlock;
+        }
+        const size_t boards = 2 * _cell.size() * sizeof(uint64_t);
+        return boards > cacheBytes(3, 32u << 20) ? TIME_BLOCK : 1;
+    }
+
+    // rows per tile so that the two strips of a tile and its halo take a quarter of L2
+    int tileRows(int generations) const
+    {
+        const size_t strip = cacheBytes(2, 1u << 20) / 8;
+        const long rows = static_cast<long>(strip / (static_cast<size_t>(_words) * sizeof(uint64_t)));
+        return static_cast<int>(std::min<long>(_row, std::max<long>(4L * generations, rows - 2L * generations)));
+    }
+
+    /*
+        generations steps of the whole board into _next, one row band at a
+        time. A band of n rows is copied with generations halo rows on each
+        side into a scratch strip and stepped there; every generation the
+        valid part shrinks by a row at both ends, so after the last one
+        exactly the band is left and goes to _next. The strip stays in
+        cache for all generations instead of the boards streaming through
+        memory once per generation.
+    */
+    template <class R>
+    void advanceBlocked(const R &rule, int generations)
+    {
+        const int band = tileRows(generations);
+        const int tiles = (_row + band - 1) / band;
+        const int workers = _pool ? _pool->bands() : 1;
+        const size_t strip = static_cast<size_t>(band + 2 * generations) * _words;
+        _strips.resize(workers);
+        for (auto &s : _strips)
+        {
+            s.first.resize(strip);
+            s.second.resize(strip);
+        }
+
+        auto job = [&](int worker) {
+            std::vector<uint64_t> &a = _strips[worker].first, &b = _strips[worker].second;
+            for (int t = worker; t < tiles; t += workers)
+            {
+                const int top = t * band, rows = std::min(band, _row - top);
+                const int height = rows + 2 * generations;
+
+                // board row top - generations + r, wrapped, goes to strip row r
+                for (int r = 0; r < height; r++)
+                {
+                    const long i = ((static_cast<long>(top) - generations + r) % _row + _row) % _row;
+                    std::copy_n(row(_cell, static_cast<int>(i)), _words, a.data() + static_cast<size_t>(r) * _words);
+                }
+
+                for (int g = 1; g <= generations; g++)
+                {
+                    for (int r = g; r < height - g; r++)
+                    {
+                        const uint64_t *mid = a.data() + static_cast<size_t>(r) * _words;
+                        stepRow(rule, mid - _words, mid, mid + _words, b.data() + static_cast<size_t>(r) * _words);
+                    }
+                    a.swap(b);
+                }
+
+                std::copy_n(a.data() + static_cast<size_t>(generations) * _words,
+                            static_cast<size_t>(rows) * _words, row(_next, top));
+            }
+        };
+
+        if (_pool)
+        {
+            _pool->run(job);
+        }
+        else
+        {
+            job(0);
+        }
+    }
+
+    uint64_t *row(std::vector<uint64_t> &v, int i)
+    {
+        return v.data() + static_cast<size_t>(i) * _words;
+    }
+
+    const uint64_t *row(const std::vector<uint64_t> &v, int i) const
+    {
+        return v.data() + static_cast<size_t>(i) * _words;
+    }
+
+    // bit j holds the cell at column j-1, column 0 wraps to column col-1
+    inline uint64_t west(const uint64_t *r, int k) const
+    {
+        const uint64_t carry = (k == 0) ? (r[_words - 1] >> ((_col - 1) & 63)) : (r[k - 1] >> 63);
+        return (r[k] << 1) | (carry & 1);
+    }
+
+    // bit j holds the cell at column j+1, column col-1 wraps to column 0
+    inline uint64_t east(const uint64_t *r, int k) const
+    {
+        if (k == _words - 1)
+        {
+            return (r[k] >> 1) | ((r[0] & 1) << ((_col - 1) & 63));
+        }
+        return (r[k] >> 1) | (r[k + 1] << 63);
+    }
+
+    // west() and east() for 0 < k < words-1, no wrap and no branch
+    static inline uint64_t westInner(const uint64_t *r, int k)
+    {
+        return (r[k] << 1) | (r[k - 1] >> 63);
+    }
+
+    static inline uint64_t eastInner(const uint64_t *r, int k)
+    {
+        return (r[k] >> 1) | (r[k + 1] << 63);
+    }
+
+    // generations per tile when the boards do not fit in the last-level cache
+    static constexpr int TIME_BLOCK = 8;
+
+    int _words;
+    uint64_t _lastMask;
+    std::vector<uint64_t> _cell;
+    std::vector<uint64_t> _next;
+    std::vector<std::pair<std::vector<uint64_t>, std::vector<uint64_t>>> _strips;    // per worker
+};
+
+/*
+    HashLife: a quadtree with hash-consed nodes and memoised results, so a
+    level-k node is advanced up to 2^(k-2) generations in one call and
+    repeated space/time patterns are computed only once. Leaves are 8x8
+    blocks held in a uint64_t, and the 16x16 base case is stepped
+    bit-parallel.
+
+    The torus is handled by tiling it over the plane. A jump of 2^j
+    generations builds a root covering [-N/4, 3N/4) of the tiling, with N at
+    least 4 * 2^j and 2 * max(rows, cols). Its result covers [0, N/2),
+    which holds one full period that is copied back into the packed board.
+    Sub-quadrants of the tiling depend only on their position modulo the
+    board size, so building the root is memoised on that too. Board sizes
+    that are powers of two share the most nodes.
+
+    Single generations (frames, cycle detection) use the packed kernel;
+    only advance() takes the quadtree path.
+*/
+class HashLife : public PackedLife
+{
+public :
+    HashLife() :
+        _limit(NODE_LIMIT),
+        _bounded(false)
+    {
+        reset();
+    }
+
+    void advance(int generations) override
+    {
+        STATS_TIMER("advance");
+
+        // largest jumps first, each a power of two
+        while (generations > 0)
+        {
+            const int j = 31 - __builtin_clz(static_cast<unsigned>(generations));
+            if (!jump(j))
+            {
+                // too little repetition for the memo to pay, step these generations plainly
+                STATS_ADD("hashlife_fallbacks", 1);
+                PackedLife::advance(1 << j);
+            }
+            generations -= 1 << j;
+        }
+    }
+
+private :
+    struct Node {
+        Node *nw, *ne, *sw, *se;   // nullptr for leaves
+        Node *next;                // memoised centre after 2^nextStep generations
+        uint64_t bits;             // leaves only, bit r*8+c is cell (r, c)
+        int level;                 // node covers 2^level x 2^level cells
+        int nextStep;
+    };
+
+    struct Key {
+        const Node *nw, *ne, *sw, *se;
+
+        bool operator==(const Key &o) const
+        {
+            return nw == o.nw && ne == o.ne && sw == o.sw && se == o.se;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &k) const
+        {
+            uint64_t h = 0x243f6a8885a308d3ull;
+            hash_combine(h, reinterpret_cast<uintptr_t>(k.nw));
+            hash_combine(h, reinterpret_cast<uintptr_t>(k.ne));
+            hash_combine(h, reinterpret_cast<uintptr_t>(k.sw));
+            hash_combine(h, reinterpret_cast<uintptr_t>(k.se));
+            return (size_t)h;
+        }
+    };
+
+    static const int LEAF = 3;
+
+    // nodes a jump may hold: a quarter node per cell, within these bounds
+    static const size_t NODE_MIN = 1u << 16;
+    static const size_t NODE_LIMIT = 1u << 22;
+
+    // thrown by leaf() and join() when a bounded jump outgrows _limit
+    struct Overflow {
+    };
+
+    void reset()
+    {
+        _table.clear();
+        _leaves.clear();
+        _built.clear();
+        _nodes.clear();
+        _empty.clear();
+        _empty.push_back(leaf(0));
+    }
+
+    Node *leaf(uint64_t bits)
+    {
+        auto loc = _leaves.find(bits);
+        if (loc != _leaves.end())
+        {
+            return loc->second;
+        }
+
+        if (_bounded && _nodes.size() >= _limit)
+        {
+            throw Overflow();
+        }
+        _nodes.push_back(Node{ nullptr, nullptr, nullptr, nullptr, nullptr, bits, LEAF, -1 });
+        Node *n = &_nodes.back();
+        _leaves.emplace(bits, n);
+        return n;
+    }
+
+    Node *join(Node *nw, Node *ne, Node *sw, Node *se)
+    {
+        const Key key{ nw, ne, sw, se };
+        auto loc = _table.find(key);
+        if (loc != _table.end())
+        {
+            return loc->second;
+        }
+
+        if (_bounded && _nodes.size() >= _limit)
+        {
+            throw Overflow();
+        }
+        _nodes.push_back(Node{ nw, ne, sw, se, nullptr, 0, nw->level + 1, -1 });
+        Node *n = &_nodes.back();
+        _table.emplace(key, n);
+        return n;
+    }
+
+    Node *empty(int level)
+    {
+        while (static_cast<int>(_empty.size()) <= level - LEAF)
+        {
+            Node *e = _empty.back();
+            _empty.push_back(join(e, e, e, e));
+        }
+        return _empty[level - LEAF];
+    }
+
+    // unpack a 16x16 node (four leaves) into rows, bit c is column c
+    static void unpack(const Node *n, uint16_t rows[16])
+    {
+        const Node *q[4] = { n->nw, n->ne, n->sw, n->se };
+        for (int r = 0; r < 16; r++)
+        {
+            const uint64_t left = q[(r / 8) * 2]->bits >> ((r % 8) * 8);
+            const uint64_t right = q[(r / 8) * 2 + 1]->bits >> ((r % 8) * 8);
+            rows[r] = static_cast<uint16_t>((left & 0xff) | ((right & 0xff) << 8));
+        }
+    }
+
+    // centre 8x8 of unpacked rows as a leaf
+    Node *pack(const uint16_t rows[16])
+    {
+        uint64_t bits = 0;
+        for (int r = 0; r < 8; r++)
+        {
+            bits |= static_cast<uint64_t>((rows[r + 4] >> 4) & 0xff) << (r * 8);
+        }
+        return leaf(bits);
+    }
+
+    // one generation of 16x16 rows; the outer ring turns invalid
+    void step16(uint16_t rows[16]) const
+    {
+        withRule(_rule, [rows](const auto &rule) {
+            uint16_t out[16] = { 0 };
+            for (int i = 1; i < 15; i++)
+            {
+                const uint64_t up = rows[i - 1], mid = rows[i], down = rows[i + 1];
+                out[i] = static_cast<uint16_t>(lifeWord(rule, up << 1, up, up >> 1,
+                                                        mid << 1, mid, mid >> 1,
+                                                        down << 1, down, down >> 1));
+            }
+            std::copy(out, out + 16, rows);
+        });
+    }
+
+    // centred sub-square one level down
+    Node *centre(Node *n)
+    {
+        if (n->level == LEAF + 1)
+        {
+            uint16_t rows[16];
+            unpack(n, rows);
+            return pack(rows);
+        }
+        return join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+    }
+
+    // centre of n after 2^j generations, j <= n->level - 2
+    Node *result(Node *n, int j)
+    {
+        if (n->next && n->nextStep == j)
+        {
+            return n->next;
+        }
+
+        Node *r;
+        if (n->level == LEAF + 1)
+        {
+            uint16_t rows[16];
+            unpack(n, rows);
+            for (int g = 0; g < (1 << j); g++)
+            {
+                step16(rows);
+            }
+            r = pack(rows);
+        }
+        else
+        {
+            // nine overlapping sub-squares one level down
+            Node *s[3][3] = {
+                { n->nw, join(n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw), n->ne },
+                { join(n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne), join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw), join(n->ne->sw, n->ne->se, n->se->nw, n->se->ne) },
+                { n->sw, join(n->sw->ne, n->se->nw, n->sw->se, n->se->sw), n->se }
+            };
+
+            // full speed advances both halves by 2^(j-1), otherwise only the second half moves
+            const bool full = (j == n->level - 2);
+            Node *t[3][3];
+            for (int a = 0; a < 3; a++)
+            {
+                for (int b = 0; b < 3; b++)
+                {
+                    t[a][b] = full ? result(s[a][b], j - 1) : centre(s[a][b]);
+                }
+            }
+
+            const int sub = full ? j - 1 : j;
+            r = join(result(join(t[0][0], t[0][1], t[1][0], t[1][1]), sub),
+                     result(join(t[0][1], t[0][2], t[1][1], t[1][2]), sub),
+                     result(join(t[1][0], t[1][1], t[2][0], t[2][1]), sub),
+                     result(join(t[1][1], t[1][2], t[2][1], t[2][2]), sub));
+        }
+
+        n->next = r;
+        n->nextStep = j;
+        return r;
+    }
+
+    // the 2^level square at (y, x) of the tiled torus
+    Node *build(int level, int64_t y, int64_t x)
+    {
+        const int64_t ry = ((y % _row) + _row) % _row;
+        const int64_t rx = ((x % _col) + _col) % _col;
+        if (level == LEAF)
+        {
+            uint64_t bits = 0;
+            for (int r = 0; r < 8; r++)
+            {
+                for (int c = 0; c < 8; c++)
+                {
+                    if (cell(static_cast<int>((ry + r) % _row), static_cast<int>((rx + c) % _col)))
+                        bits |= 1ull << (r * 8 + c);
+                }
+            }
+            return leaf(bits);
+        }
+
+        const uint64_t key = (static_cast<uint64_t>(level) << 58) | (static_cast<uint64_t>(ry) << 29) | static_cast<uint64_t>(rx);
+        auto loc = _built.find(key);
+        if (loc != _built.end())
+        {
+            return loc->second;
+        }
+
+        const int64_t half = int64_t(1) << (level - 1);
+        Node *n = join(build(level - 1, y, x), build(level - 1, y, x + half),
+                       build(level - 1, y + half, x), build(level - 1, y + half, x + half));
+        _built.emplace(key, n);
+        return n;
+    }
+
+    // copy the part of n at (y, x) that lies on the board
+    void extract(Node *n, int64_t y, int64_t x)
+    {
+        if (y >= _row || x >= _col || n == empty(n->level))
+        {
+            return;
+        }
+        if (n->level == LEAF)
+        {
+            for (int r = 0; r < 8 && y + r < _row; r++)
+            {
+                for (int c = 0; c < 8 && x + c < _col; c++)
+                {
+                    if ((n->bits >> (r * 8 + c)) & 1)
+                        setCell(static_cast<int>(y + r), static_cast<int>(x + c), true);
+                }
+            }
+            return;
+        }
+
+        const int64_t half = int64_t(1) << (n->level - 1);
+        extract(n->nw, y, x);
+        extract(n->ne, y, x + half);
+        extract(n->sw, y + half, x);
+        extract(n->se, y + half, x + half);
+    }
+
+    // advance 2^j generations, false with the board untouched when the nodes outgrew _limit
+    bool jump(int j)
+    {
+        int span = 0;
+        while ((int64_t(1) << span) < std::max(_row, _col))
+        {
+            span++;
+        }
+
+        const int level = std::max({ j + 2, span + 1, LEAF + 1 });
+        const int64_t size = int64_t(1) << level;
+
+        _limit = std::min(std::max(static_cast<size_t>(_row) * _col / 4, NODE_MIN), NODE_LIMIT);
+        Node *r;
+        try
+        {
+            _bounded = true;
+            Node *root = build(level, -size / 4, -size / 4);
+            _built.clear();
+            r = result(root, j);
+            _bounded = false;
+        }
+        catch (const Overflow &)
+        {
+            _bounded = false;
+            reset();
+            return false;
+        }
+
+        clearBoard();
+        extract(r, 0, 0);
+
+        // keep the memo for the next jump while it leaves room
+        if (_nodes.size() > _limit / 2)
+        {
+            reset();
+        }
+        return true;
+    }
+
+    std::deque<Node> _nodes;
+    std::unordered_map<Key, Node*, KeyHash> _table;
+    std::unordered_map<uint64_t, Node*> _leaves;
+    std::unordered_map<uint64_t, Node*> _built;
+    std::vector<Node*> _empty;
+    size_t _limit;
+    bool _bounded;          // leaf() and join() enforce _limit
+};
+
+#ifdef WITH_CUDA
+/*
+    PackedLife's board kept in GPU memory (make CUDA=1), see gol_cuda.cu.
+    Both generations stay on the device; the host copy is only refreshed
+    when a cell, hash or snapshot is asked for, and pushed back before the
+    next step when it was edited. A --final-only run therefore copies the
+    board out once, for the last frame.
+*/
+class CudaLife : public GameOfLife
+{
+public :
+    CudaLife() :
+        _words(0),
+        _device(nullptr),
+        _hostValid(true),
+        _deviceValid(true)
+    {
+    }
+
+    virtual ~CudaLife()
+    {
+        cudaBoardDestroy(_device);
+    }
+
+protected :
+    void stepRows(int begin, int end) override
+    {
+        upload();
+        if (!cudaBoardStep(_device, begin, end, _rule.birth, _rule.survive))
+        {
+            fail("step");
+        }
+    }
+
+    void allocate() override
+    {
+        // one kernel launch covers the board, row bands only add launches
+        _threads = 1;
+        _words = (_col + 63) / 64;
+        _host.assign(static_cast<size_t>(_row) * _words, 0);
+
+        cudaBoardDestroy(_device);
+        _device = cudaBoardCreate(_row, _col);
+        if (!_device)
+        {
+            fail("allocate");
+        }
+        _hostValid = true;
+        _deviceValid = true;
+    }
+
+    void update() override
+    {
+        cudaBoardSwap(_device);
+        _hostValid = false;
+    }
+
+    bool cell(int i, int j) const override
+    {
+        download();
+        return (_host[static_cast<size_t>(i) * _words + (j >> 6)] >> (j & 63)) & 1;
+    }
+
+    void setCell(int i, int j, bool alive) override
+    {
+        download();
+        uint64_t &w = _host[static_cast<size_t>(i) * _words + (j >> 6)];
+        const uint64_t bit = 1ull << (j & 63);
+        w = alive ? (w | bit) : (w & ~bit);
+        _deviceValid = false;
+    }
+
+    size_t hashState() override
+    {
+        download();
+        uint64_t h = 0x243f6a8885a308d3ull;
+        hash_combine(h, (uint64_t)_row);
+        hash_combine(h, (uint64_t)_col);
+        for (uint64_t w : _host)
+        {
+            hash_combine(h, w);
+        }
+        return (size_t)h;
+    }
+
+    void save(Snapshot &s) const override
+    {
+        download();
+        s = _host;
+    }
+
+    void load(const Snapshot &s) override
+    {
+        _host = s;
+        _hostValid = true;
+        _deviceValid = false;
+    }
+
+private :
+    // refresh the host copy after the device stepped
+    void download() const
+    {
+        if (!_hostValid)
+        {
+            STATS_TIMER("cuda_download");
+            if (!cudaBoardDownload(_device, _host.data()))
+            {
+                fail("download");
+            }
+            _hostValid = true;
+        }
+    }
+
+    // push host edits before the device reads the board again
+    void upload()
+    {
+        if (!_deviceValid)
+        {
+            STATS_TIMER("cuda_upload");
+            if (!cudaBoardUpload(_device, _host.data()))
+            {
+                fail("upload");
+            }
+            _deviceValid = true;
+        }
+    }
+
+    [[noreturn]] static void fail(const char *what)
+    {
+        throw std::runtime_error(std::string("CUDA ") + what + ": " + cudaBoardError());
+    }
+
+    int _words;
+    void *_device;
+    mutable Snapshot _host;
+    mutable bool _hostValid;
+    bool _deviceValid;
+};
+#endif
+
+/*
+    Many independent boards of the same size, bit-sliced 64 to a block:
+    word (i, j) of a block holds cell (i, j) of 64 boards, bit b for board
+    b. lifeWord() then steps 64 boards per word op with no shifts, and
+    rows of words vectorise. Blocks are spread over a BandPool.
+
+    Cycles are found per lane with Brent's algorithm. Its schedule does not
+    depend on the board, so one tortoise block serves all 64 lanes and the
+    step also ORs every new word against it: lane b repeats exactly when
+    bit b of that mask stays clear. The first repeat is then found by
+    replaying the seed next to a copy advanced by each lane's own period.
+*/
+class BatchLife
+{
+public :
+    struct Result {
+        long long seed;
+        long population;    // at the first repeat, or after the last step
+        int period;         // 0 when no cycle showed up within the steps
+        int repeat;         // generation that first equals an earlier one
+    };
+
+    BatchLife(int row, int col, int steps, int threads, const Rule &rule) :
+        _row(row),
+        _col(col),
+        _steps(steps),
+        _threads(threads),
+        _rule(rule)
+    {
+        if (row <= 0 || col <= 0 || steps <= 0)
+        {
+            throw std::invalid_argument("Row, col, and steps must be positive");
+        }
+    }
+
+    // board k is the random board gol -S seed+k would start from
+    std::vector<Result> run(long boards, long long seed)
+    {
+        std::vector<Result> results(boards);
+        const long blocks = (boards + 63) / 64;
+        std::atomic<long> next(0);
+
+        BandPool pool(static_cast<int>(std::max(1L, std::min<long>(_threads, blocks))));
+        pool.run([&](int) {
+            for (long b = next++; b < blocks; b = next++)
+            {
+                const int lanes = static_cast<int>(std::min<long>(64, boards - b * 64));
+                runBlock(&results[b * 64], lanes, seed + b * 64);
+            }
+        });
+
+        STATS_ADD("boards", boards);
+        return results;
+    }
+
+private :
+    typedef std::vector<uint64_t> Block;
+
+    // one cell of 64 boards, the words west/east of column c are w and e
+    template <class R>
+    static inline uint64_t cellWord(const R &rule, const uint64_t *up, const uint64_t *mid,
+                                    const uint64_t *down, int w, int c, int e)
+    {
+        return lifeWord(rule, up[w], up[c], up[e], mid[w], mid[c], mid[e], down[w], down[c], down[e]);
+    }
+
+    // next generation of cell into next, returns the lanes where it differs from ref
+    uint64_t step(const Block &cell, Block &next, const Block &ref) const
+    {
+        uint64_t diff = 0;
+        withRule(_rule, [&](const auto &rule) {
+            diff = stepWith(rule, cell, next, ref);
+        });
+        return diff;
+    }
+
+    template <class R>
+    uint64_t stepWith(const R &rule, const Block &cell, Block &next, const Block &ref) const
+    {
+        uint64_t diff = 0;
+        for (int i = 0; i < _row; i++)
+        {
+            const uint64_t *up = &cell[static_cast<size_t>(i == 0 ? _row - 1 : i - 1) * _col];
+            const uint64_t *mid = &cell[static_cast<size_t>(i) * _col];
+            const uint64_t *down = &cell[static_cast<size_t>(i == _row - 1 ? 0 : i + 1) * _col];
+            uint64_t *out = &next[static_cast<size_t>(i) * _col];
+            const uint64_t *r = &ref[static_cast<size_t>(i) * _col];
+
+            if (_col == 1)
+            {
+                out[0] = cellWord(rule, up, mid, down, 0, 0, 0);
+                diff |= out[0] ^ r[0];
+                continue;
+            }
+
+            out[0] = cellWord(rule, up, mid, down, _col - 1, 0, 1);
+            for (int j = 1; j < _col - 1; j++)
+            {
+                out[j] = cellWord(rule, up, mid, down, j - 1, j, j + 1);
+            }
+            out[_col - 1] = cellWord(rule, up, mid, down, _col - 2, _col - 1, 0);
+
+            for (int j = 0; j < _col; j++)
+            {
+                diff |= out[j] ^ r[j];
+            }
+        }
+        return diff;
+    }
+
+    // live cells of every lane in mask
+    static void count(const Block &cell, uint64_t mask, Result *results)
+    {
+        long pop[64] = {};
+        for (uint64_t w : cell)
+        {
+            for (w &= mask; w; w &= w - 1)
+            {
+                pop[__builtin_ctzll(w)]++;
+            }
+        }
+        for (int b = 0; b < 64; b++)
+        {
+            if ((mask >> b) & 1) results[b].population = pop[b];
+        }
+    }
+
+    void runBlock(Result *results, int lanes, long long seed) const
+    {
+        STATS_TIMER("batch");
+        const size_t cells = static_cast<size_t>(_row) * _col;
+        const uint64_t all = lanes == 64 ? ~0ull : (1ull << lanes) - 1;
+
+        // same draws as initBoard(), one generator per lane
+        Block origin(cells, 0);
+        for (int b = 0; b < lanes; b++)
+        {
+            std::mt19937 gen(static_cast<std::mt19937::result_type>(seed + b));
+            std::uniform_int_distribution<> distrib(0, 1);
+            for (size_t k = 0; k < cells; k++)
+            {
+                origin[k] |= static_cast<uint64_t>(distrib(gen) == 1) << b;
+            }
+            results[b].seed = seed + b;
+            results[b].period = 0;
+            results[b].repeat = 0;
+        }
+
+        // Brent on all lanes at once, cur is generation g and tortoise generation start. A lane
+        // repeating by _steps is only caught once start has passed its tail, so run on until
+        // start reaches _steps and the hare is _steps further, keeping generation _steps in last
+        Block cur = origin, next(cells), tortoise = origin, last = origin;
+        uint64_t found = 0;
+        long long power = 1, start = 0, g = 1;
+        int lam = 0;
+        for (; found != all && (start < _steps || g <= start + _steps); g++)
+        {
+            const uint64_t diff = step(cur, next, tortoise);
+            cur.swap(next);
+            ++lam;
+            if (g == _steps)
+            {
+                last = cur;
+            }
+
+            for (uint64_t hit = ~diff & all & ~found; hit; hit &= hit - 1)
+            {
+                results[__builtin_ctzll(hit)].period = lam;
+            }
+            found |= ~diff & all;
+
+            if (lam == power)
+            {
+                tortoise = cur;
+                start = g;
+                power *= 2;
+                lam = 0;
+            }
+        }
+        STATS_ADD("generations", static_cast<double>(lanes) * (g - 1));
+        count(last, all & ~found, results);
+        if (!found)
+        {
+            return;
+        }
+
+        // ahead holds each lane advanced by its own period
+        Block ahead = origin;
+        int longest = 0;
+        for (int b = 0; b < 64; b++)
+        {
+            if ((found >> b) & 1) longest = std::max(longest, results[b].period);
+        }
+        cur = origin;
+        for (int g = 1; g <= longest; g++)
+        {
+            step(cur, next, cur);
+            cur.swap(next);
+
+            uint64_t lane = 0;
+            for (int b = 0; b < 64; b++)
+            {
+                if (((found >> b) & 1) && results[b].period == g) lane |= 1ull << b;
+            }
+            if (lane)
+            {
+                for (size_t k = 0; k < cells; k++)
+                {
+                    ahead[k] = (ahead[k] & ~lane) | (cur[k] & lane);
+                }
+            }
+        }
+
+        // walk both until the lane matches, generation m + period is the repeat
+        cur = origin;
+        Block aheadNext(cells);
+        uint64_t diff = 0;
+        for (size_t k = 0; k < cells; k++)
+        {
+            diff |= cur[k] ^ ahead[k];
+        }
+        uint64_t open = found;
+        for (int m = 0; open; m++)
+        {
+            const uint64_t hit = ~diff & open;
+            if (hit)
+            {
+                count(cur, hit, results);
+                for (uint64_t h = hit; h; h &= h - 1)
+                {
+                    Result &r = results[__builtin_ctzll(h)];
+                    r.repeat = m + r.period;
+                }
+                open &= ~hit;
+            }
+
+            step(cur, next, cur);
+            cur.swap(next);
+            diff = step(ahead, aheadNext, cur);
+            ahead.swap(aheadNext);
+        }
+
+        // caught past _steps, no repeat within the run
+        uint64_t late = 0;
+        for (uint64_t f = found; f; f &= f - 1)
+        {
+            Result &r = results[__builtin_ctzll(f)];
+            if (r.repeat > _steps)
+            {
+                r.period = 0;
+                r.repeat = 0;
+                late |= f & -f;
+            }
+        }
+        count(last, late, results);
+    }
+
+    int _row;
+    int _col;
+    int _steps;
+    int _threads;
+    Rule _rule;
+};
+
+#ifdef WITH_MPI
+/*
+    One block of a torus split over MPI ranks (--distributed). The ranks
+    form a periodic P x Q grid from MPI_Dims_create and rank (p, q) owns
+    rows [R*p/P, R*(p+1)/P) and the matching columns, packed like
+    PackedLife with a one-cell halo on every side: local rows 0 and h+1,
+    bits 0 and w+1 of each row.
+
+    step() posts the eight edge pieces to the neighbours, steps the rows
+    that need no halo row while they travel, then fills the halo and
+    finishes the first and last rows and the words next to the halo
+    columns. Cycle detection XORs one mixed hash per block with
+    MPI_Allreduce, so every rank keeps the same history and stops at the
+    same generation.
+*/
+class DistLife
+{
+public :
+    DistLife(int row, int col, int threads, const Rule &rule) :
+        _row(row),
+        _col(col),
+        _rule(rule)
+    {
+        if (row <= 0 || col <= 0)
+        {
+            throw std::invalid_argument("Row and col must be positive");
+        }
+
+        int size;
+        MPI_Comm_size(MPI_COMM_WORLD, &size);
+        int dims[2] = { 0, 0 }, periods[2] = { 1, 1 };
+        MPI_Dims_create(size, 2, dims);
+        if (row < dims[0] || col < dims[1])
+        {
+            throw std::invalid_argument("Board is smaller than the " + std::to_string(dims[0]) + "x"
+                                        + std::to_string(dims[1]) + " rank grid");
+        }
+        MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &_comm);
+        MPI_Comm_rank(_comm, &_rank);
+
+        int at[2];
+        MPI_Cart_coords(_comm, _rank, 2, at);
+        _top = static_cast<int>(static_cast<long>(row) * at[0] / dims[0]);
+        _h = static_cast<int>(static_cast<long>(row) * (at[0] + 1) / dims[0]) - _top;
+        _left = static_cast<int>(static_cast<long>(col) * at[1] / dims[1]);
+        _w = static_cast<int>(static_cast<long>(col) * (at[1] + 1) / dims[1]) - _left;
+
+        _words = (_w + 2 + 63) / 64;
+        // the last word always holds bit w+1, so it never has all 64 bits owned
+        _lastMask = (1ull << ((_w + 1) % 64)) - 1;
+        _cell.assign(static_cast<size_t>(_h + 2) * _words, 0);
+        _next.assign(static_cast<size_t>(_h + 2) * _words, 0);
+
+        for (int d = 0; d < 8; d++)
+        {
+            // out of range coordinates wrap on a periodic grid
+            int to[2] = { at[0] + DR[d], at[1] + DC[d] };
+            MPI_Cart_rank(_comm, to, &_peer[d]);
+
+            const size_t words = DC[d] == 0 ? (_w + 63) / 64 : DR[d] == 0 ? (_h + 63) / 64 : 1;
+            _send[d].assign(words, 0);
+            _recv[d].assign(words, 0);
+        }
+
+        if (std::min(threads, _h) > 1)
+        {
+            _pool = std::make_unique<BandPool>(std::min(threads, _h));
+        }
+    }
+
+    ~DistLife()
+    {
+        MPI_Comm_free(&_comm);
+    }
+
+    int rank() const
+    {
+        return _rank;
+    }
+
+    /*
+        The seed pattern, or a random board drawn per 64-cell word: word k of
+        row i is splitmix64 of (seed, i, k), so a rank only draws the words
+        its block touches and the board does not depend on the rank count.
+        It is not the mt19937 board a single-process run draws for --seed.
+    */
+    void initBoard(long long seed, const SeedFile *pattern)
+    {
+        if (pattern)
+        {
+            if (pattern->height() > _row || pattern->width() > _col)
+            {
+                throw std::invalid_argument("Seed pattern is larger than the board");
+            }
+
+            const int top = (_row - pattern->height()) / 2;
+            const int left = (_col - pattern->width()) / 2;
+            pattern->decode([this, top, left](int i, int j) {
+                place(top + i, left + j);
+            });
+            return;
+        }
+
+        unsigned long long s = static_cast<unsigned long long>(seed);
+        if (seed < 0)
+        {
+            std::random_device rd;
+            s = rd();
+        }
+        MPI_Bcast(&s, 1, MPI_UNSIGNED_LONG_LONG, 0, _comm);
+
+        const uint64_t key = GameOfLife::splitmix64(s);
+        for (int i = _top; i < _top + _h; i++)
+        {
+            for (int k = _left >> 6; k <= (_left + _w - 1) >> 6; k++)
+            {
+                uint64_t bits = GameOfLife::splitmix64(key ^ GameOfLife::splitmix64(
+                    static_cast<uint64_t>(i) << 32 | static_cast<uint32_t>(k)));
+                for (; bits; bits &= bits - 1)
+                {
+                    // place() drops the columns outside the block
+                    place(i, k * 64 + __builtin_ctzll(bits));
+                }
+            }
+        }
+    }
+
+    // the run loop of GameOfLife::start(), a "Cycle: N population P" line per shown generation
+    void run(int steps, bool finalOnly, bool detectCycle)
+    {
+        std::unordered_set<uint64_t> history;
+        if (!finalOnly)
+        {
+            show(0);
+        }
+
+        for (int i = 0; i < steps; i++)
+        {
+            if (detectCycle && !history.insert(hash()).second)
+            {
+                if (_rank == 0)
+                {
+                    std::cout << "Cycle detected. Stop calculating." << std::endl;
+                }
+                break;
+            }
+
+            step();
+            STATS_ADD("generations", 1);
+            if (!finalOnly || i == steps - 1)
+            {
+                show(i + 1);
+            }
+        }
+
+        if (detectCycle)
+        {
+            STATS_SET("history_size", history.size());
+        }
+    }
+
+    void step()
+    {
+        STATS_TIMER("step");
+        MPI_Request requests[16];
+        for (int d = 0; d < 8; d++)
+        {
+            // piece d travels towards peer d and fills the halo on the opposite side there
+            pack(d, _send[d]);
+            MPI_Irecv(_recv[d].data(), static_cast<int>(_recv[d].size()), MPI_UINT64_T, _peer[OPP[d]], d,
+                      _comm, &requests[d]);
+            MPI_Isend(_send[d].data(), static_cast<int>(_send[d].size()), MPI_UINT64_T, _peer[d], d,
+                      _comm, &requests[8 + d]);
+        }
+
+        withRule(_rule, [this](const auto &rule) {
+            stepInterior(rule);
+        });
+
+        {
+            STATS_TIMER("halo");
+            MPI_Waitall(16, requests, MPI_STATUSES_IGNORE);
+        }
+        for (int d = 0; d < 8; d++)
+        {
+            unpack(OPP[d], _recv[d]);
+        }
+
+        withRule(_rule, [this](const auto &rule) {
+            stepBorder(rule);
+        });
+        _cell.swap(_next);
+    }
+
+    // live cells on the whole board, on rank 0
+    long long population() const
+    {
+        long long local = 0, all = 0;
+        for (int i = 1; i <= _h; i++)
+        {
+            for (int k = 0; k < _words; k++)
+            {
+                local += __builtin_popcountll(owned(row(_cell, i)[k], k));
+            }
+        }
+        MPI_Reduce(&local, &all, 1, MPI_LONG_LONG, MPI_SUM, 0, _comm);
+        return all;
+    }
+
+    // whole-board hash on every rank, blocks are told apart by their position
+    uint64_t hash() const
+    {
+        STATS_TIMER("hash");
+        uint64_t h = 0x243f6a8885a308d3ull;
+        GameOfLife::hash_combine(h, static_cast<uint64_t>(static_cast<uint32_t>(_top)) << 32
+                                    | static_cast<uint32_t>(_left));
+        for (int i = 1; i <= _h; i++)
+        {
+            for (int k = 0; k < _words; k++)
+            {
+                GameOfLife::hash_combine(h, owned(row(_cell, i)[k], k));
+            }
+        }
+
+        const uint64_t mixed = GameOfLife::splitmix64(h);
+        uint64_t all = 0;
+        MPI_Allreduce(&mixed, &all, 1, MPI_UINT64_T, MPI_BXOR, _comm);
+        return all;
+    }
+
+private :
+    // N, S, W, E, NW, NE, SW, SE and the direction opposite each
+    static constexpr int DR[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+    static constexpr int DC[8] = { 0, 0, -1, 1, -1, 1, -1, 1 };
+    static constexpr int OPP[8] = { 1, 0, 3, 2, 7, 6, 5, 4 };
+
+    uint64_t *row(std::vector<uint64_t> &grid, int i)
+    {
+        return &grid[static_cast<size_t>(i) * _words];
+    }
+
+    const uint64_t *row(const std::vector<uint64_t> &grid, int i) const
+    {
+        return &grid[static_cast<size_t>(i) * _words];
+    }
+
+    // word k of a row without its halo bits
+    uint64_t owned(uint64_t w, int k) const
+    {
+        if (k == 0) w &= ~1ull;
+        if (k == _words - 1) w &= _lastMask;
+        return w;
+    }
+
+    // local bit j is column j - 1 of the block
+    bool bit(int i, int j) const
+    {
+        return (row(_cell, i)[j >> 6] >> (j & 63)) & 1;
+    }
+
+    void setBit(int i, int j, bool alive)
+    {
+        uint64_t &w = row(_cell, i)[j >> 6];
+        const uint64_t mask = 1ull << (j & 63);
+        w = alive ? (w | mask) : (w & ~mask);
+    }
+
+    // global cell (i, j) when this block owns it
+    void place(int i, int j)
+    {
+        if (i >= _top && i < _top + _h && j >= _left && j < _left + _w)
+        {
+            setBit(i - _top + 1, j - _left + 1, true);
+        }
+    }
+
+    // edge cells on side d: a row or column of the block, or a corner cell
+    void pack(int d, std::vector<uint64_t> &buf) const
+    {
+        std::fill(buf.begin(), buf.end(), 0);
+        const int i = DR[d] < 0 ? 1 : _h, j = DC[d] < 0 ? 1 : _w;
+        if (DC[d] == 0)
+        {
+            // bits 1..w down to 0..w-1
+            const uint64_t *r = row(_cell, i);
+            for (size_t k = 0; k < buf.size(); k++)
+            {
+                buf[k] = (r[k] >> 1) | (k + 1 < static_cast<size_t>(_words) ? r[k + 1] << 63 : 0);
+            }
+            if (_w % 64)
+            {
+                buf.back() &= (1ull << (_w % 64)) - 1;
+            }
+        }
+        else if (DR[d] == 0)
+        {
+            for (int y = 0; y < _h; y++)
+            {
+                buf[y >> 6] |= static_cast<uint64_t>(bit(y + 1, j)) << (y & 63);
+            }
+        }
+        else
+        {
+            buf[0] = bit(i, j);
+        }
+    }
+
+    // halo cells on side s from the neighbour's edge piece; rows go first so
+    // the corners land on top of them
+    void unpack(int s, const std::vector<uint64_t> &buf)
+    {
+        const int i = DR[s] < 0 ? 0 : _h + 1, j = DC[s] < 0 ? 0 : _w + 1;
+        if (DC[s] == 0)
+        {
+            uint64_t *r = row(_cell, i);
+            for (int k = 0; k < _words; k++)
+            {
+                const uint64_t here = static_cast<size_t>(k) < buf.size() ? buf[k] : 0;
+                r[k] = (here << 1) | (k > 0 ? buf[k - 1] >> 63 : 0);
+            }
+            r[0] &= ~1ull;
+            r[_words - 1] &= _lastMask;
+        }
+        else if (DR[s] == 0)
+        {
+            for (int y = 0; y < _h; y++)
+            {
+                setBit(y + 1, j, (buf[y >> 6] >> (y & 63)) & 1);
+            }
+        }
+        else
+        {
+            setBit(i, j, buf[0] & 1);
+        }
+    }
+
+    // next state of word k in local row i
+    template <class R>
+    void stepWord(const R &rule, int i, int k)
+    {
+        const uint64_t *up = row(_cell, i - 1), *mid = row(_cell, i), *down = row(_cell, i + 1);
+        row(_next, i)[k] = owned(lifeWord(rule, west(up, k), up[k], east(up, k),
+                                          west(mid, k), mid[k], east(mid, k),
+                                          west(down, k), down[k], east(down, k)), k);
+    }
+
+    template <class R>
+    void stepRow(const R &rule, int i)
+    {
+        for (int k = 0; k < _words; k++)
+        {
+            stepWord(rule, i, k);
+        }
+    }
+
+    // rows 2..h-1 read no halo row; their words next to a halo column are redone by stepBorder()
+    template <class R>
+    void stepInterior(const R &rule)
+    {
+        const int rows = std::max(0, _h - 2);
+        if (!_pool)
+        {
+            for (int i = 2; i < _h; i++)
+            {
+                stepRow(rule, i);
+            }
+            return;
+        }
+
+        const int bands = _pool->bands();
+        _pool->run([this, &rule, rows, bands](int band) {
+            for (int i = 2 + rows * band / bands; i < 2 + rows * (band + 1) / bands; i++)
+            {
+                stepRow(rule, i);
+            }
+        });
+    }
+
+    template <class R>
+    void stepBorder(const R &rule)
+    {
+        stepRow(rule, 1);
+        if (_h > 1)
+        {
+            stepRow(rule, _h);
+        }
+
+        // bit 0 feeds word 0, bit w+1 the last word and, at a word boundary, the one before
+        for (int i = 2; i < _h; i++)
+        {
+            stepWord(rule, i, 0);
+            stepWord(rule, i, _w >> 6);
+            stepWord(rule, i, _words - 1);
+        }
+    }
+
+    // bit j of west is column j-1, of east column j+1; the halo bits close off the row
+    uint64_t west(const uint64_t *r, int k) const
+    {
+        return (r[k] << 1) | (k > 0 ? r[k - 1] >> 63 : 0);
+    }
+
+    uint64_t east(const uint64_t *r, int k) const
+    {
+        return (r[k] >> 1) | (k < _words - 1 ? r[k + 1] << 63 : 0);
+    }
+
+    void show(int generation) const
+    {
+        const long long p = population();
+        if (_rank == 0)
+        {
+            std::cout << "Cycle: " << generation << " population " << p << '\n';
+        }
+    }
+
+    int _row;
+    int _col;
+    Rule _rule;
+    MPI_Comm _comm;
+    int _rank;
+
+    // the block is rows [_top, _top + _h) and columns [_left, _left + _w)
+    int _top;
+    int _h;
+    int _left;
+    int _w;
+    int _words;
+    uint64_t _lastMask;     // bits of the last word below w+1
+    std::vector<uint64_t> _cell;
+    std::vector<uint64_t> _next;
+
+    int _peer[8];
+    std::vector<uint64_t> _send[8];
+    std::vector<uint64_t> _recv[8];
+    std::unique_ptr<BandPool> _pool;
+};
+#endif
+
+std::unique_ptr<GameOfLife> GameOfLife::create(const std::string &engine)
+{
+    if (engine == "bool")
+    {
+        return std::make_unique<BoolLife>();
+    }
+    if (engine == "packed")
+    {
+        return std::make_unique<PackedLife>();
+    }
+    if (engine == "hashlife")
+    {
+        return std::make_unique<HashLife>();
+    }
+#ifdef WITH_CUDA
+    if (engine == "cuda")
+    {
+        return std::make_unique<CudaLife>();
+    }
+#endif
+    return nullptr;
+}
+
+#ifndef GOL_BENCH
+static void printStats(const Option &option)
+{
+    if (option.stats)
+    {
+        if (STATS_ENABLED)
+        {
+            STATS_JSON(std::cerr);
+        }
+        else
+        {
+            std::cerr << "--stats needs a build with STATS=1" << std::endl;
+        }
+    }
+}
+
+// --batch: one line per board, '-' where no cycle showed up within the steps
+static int runBatch(const Option &option, const Rule &rule)
+{
+    if (!option.seed_file.empty())
+    {
+        std::cerr << "--batch runs random boards, not --seed-file" << std::endl;
+        return 1;
+    }
+
+    std::random_device rd;
+    const long long seed = option.seed >= 0 ? option.seed : rd();
+
+    std::vector<BatchLife::Result> results;
+    try
+    {
+        BatchLife batch(option.rows, option.cols, option.steps, option.threads, rule);
+        results = batch.run(option.batch, seed);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "board seed population period repeat" << std::endl;
+    for (size_t k = 0; k < results.size(); k++)
+    {
+        const BatchLife::Result &r = results[k];
+        std::cout << k << ' ' << r.seed << ' ' << r.population << ' ';
+        if (r.period)
+        {
+            std::cout << r.period << ' ' << r.repeat << '\n';
+        }
+        else
+        {
+            std::cout << "- -\n";
+        }
+    }
+    std::cout.flush();
+
+    printStats(option);
+    return 0;
+}
+
+// --distributed: every rank steps its block, rank 0 prints
+static int runDistributed(Option &option, const Rule &rule, const SeedFile *pattern)
+{
+#ifdef WITH_MPI
+    int provided;
+    MPI_Init_thread(nullptr, nullptr, MPI_THREAD_FUNNELED, &provided);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0)
+    {
+        option.print(std::cout);
+    }
+
+    // the same checks fail on every rank, so they all leave together
+    std::string error;
+    if (option.batch > 0 || option.checkpoint_every > 0 || option.resume)
+    {
+        error = "--distributed does not batch or checkpoint";
+    }
+    else if (option.output_format != "text")
+    {
+        error = "--distributed prints populations, not --output-format frames";
+    }
+    else if (option.detect_cycle && option.cycle_algo != "set")
+    {
+        error = "--distributed detects cycles with --cycle-algo set only";
+    }
+    else
+    {
+        try
+        {
+            DistLife life(option.rows, option.cols, option.threads, rule);
+            life.initBoard(option.seed, pattern);
+            life.run(option.steps, option.final_only, option.detect_cycle);
+            std::cout.flush();
+        }
+        catch (const std::exception &e)
+        {
+            error = e.what();
+        }
+    }
+
+    if (rank == 0)
+    {
+        if (!error.empty())
+        {
+            std::cerr << "Error: " << error << std::endl;
+        }
+        printStats(option);
+    }
+    MPI_Finalize();
+    return error.empty() ? 0 : 1;
+#else
+    (void)option;
+    (void)rule;
+    (void)pattern;
+    std::cerr << "--distributed needs a build with MPI=1" << std::endl;
+    return 1;
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    // frames bypass stdio, everything else goes through an unsynchronised cout
+    std::ios::sync_with_stdio(false);
+
+    Option option;
+    option.get(argc, argv);
+
+    // the board defaults to the size of the seed pattern
+    SeedFile pattern;
+    if (!option.seed_file.empty())
+    {
+        try
+        {
+            pattern.open(option.seed_file);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        if (option.rows <= 0) option.rows = pattern.height();
+        if (option.cols <= 0) option.cols = pattern.width();
+    }
+
+    // a missing checkpoint starts a new run, so the same command line can be rerun after a crash
+    Checkpoint checkpoint;
+    bool resumed = false;
+    if ((option.checkpoint_every > 0 || option.resume) && option.checkpoint_file.empty())
+    {
+        std::cerr << "--checkpoint-every and --resume need --checkpoint-file" << std::endl;
+        return 1;
+    }
+    if (option.resume && access(option.checkpoint_file.c_str(), F_OK) == 0)
+    {
+        try
+        {
+            checkpoint.open(option.checkpoint_file);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        resumed = true;
+        if (option.rows <= 0) option.rows = checkpoint.rows();
+        if (option.cols <= 0) option.cols = checkpoint.cols();
+        if (checkpoint.generation() > std::max(option.steps, 0))
+        {
+            std::cerr << "Checkpoint is at generation " << checkpoint.generation()
+                      << ", past --steps " << option.steps << std::endl;
+            return 1;
+        }
+    }
+
+    FrameWriter::Format format;
+    if (!FrameWriter::parseFormat(option.output_format, format))
+    {
+        std::cerr << "Unknown output format: " << option.output_format << std::endl;
+        return 1;
+    }
+
+    // --rule wins over the one in the seed file or the checkpoint; a seed
+    // file rule that is not B/S (e.g. a Golly rule table) runs as Life
+    Rule rule;
+    if (!option.rule.empty() && !Rule::parse(option.rule, rule))
+    {
+        std::cerr << "Unknown rule: " << option.rule << std::endl;
+        return 1;
+    }
+    if (option.rule.empty() && !pattern.rule().empty() && !Rule::parse(pattern.rule(), rule))
+    {
+        std::cerr << "Unknown rule in " << option.seed_file << ": " << pattern.rule()
+                  << ", using B3/S23" << std::endl;
+    }
+    if (resumed && option.rule.empty())
+    {
+        rule.birth = checkpoint.birth();
+        rule.survive = checkpoint.survive();
+    }
+    option.rule = rule.name();
+    if (option.distributed)
+    {
+        return runDistributed(option, rule, option.seed_file.empty() ? nullptr : &pattern);
+    }
+    option.print(format == FrameWriter::TEXT ? std::cout : std::cerr);
+
+    if (option.batch > 0)
+    {
+        if (option.checkpoint_every > 0 || option.resume)
+        {
+            std::cerr << "--batch does not checkpoint" << std::endl;
+            return 1;
+        }
+        return runBatch(option, rule);
+    }
+
+    std::unique_ptr<GameOfLife> gol = GameOfLife::create(option.engine);
+    if (!gol)
+    {
+        std::cerr << "Unknown engine: " << option.engine << std::endl;
+        return 1;
+    }
+    gol->setThreads(option.threads);
+    gol->setOutputFormat(format);
+    gol->setRule(rule);
+    gol->setTimeBlock(option.time_block);
+    gol->setCheckpoint(option.checkpoint_file, option.checkpoint_every);
+    if (resumed)
+    {
+        gol->setResume(&checkpoint);
+    }
+    gol->setSeed(option.seed);
+    if (!option.seed_file.empty())
+    {
+        gol->setPattern(&pattern);
+    }
+    if (option.cycle_algo == "brent")
+    {
+        gol->setCycleAlgo(GameOfLife::CYCLE_BRENT);
+    }
+    else if (option.cycle_algo != "set")
+    {
+        std::cerr << "Unknown cycle algo: " << option.cycle_algo << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        gol->initBoard(option.rows, option.cols, option.steps, option.final_only, option.detect_cycle);
+        gol->start();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
 
+    printStats(option);
     return 0;
 }
+#endif
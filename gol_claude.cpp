@@ -7,6 +7,7 @@
 
 *****************************************************************************/
 
+#include <algorithm>
 #include <cstdint>
 #include <cstddef>
 #include <cstdlib>
@@ -102,10 +103,22 @@ struct Option {
     bool detect_cycle;
 };
 
+/*
+    The board is split into TILE x TILE tiles. A tile whose own cells and all
+    eight neighbouring tiles were unchanged last generation cannot change now,
+    and both buffers already hold the same cells for it, so step() skips it.
+
+    With --detect-cycle the board hash is the XOR of per-tile hashes
+    (Zobrist style, keyed by the tile index), so step() only rehashes the
+    tiles it rewrote and hashState() is O(1). Without it no hashes are kept.
+*/
 class GameOfLife
 {
 public:
-    GameOfLife() : _row(0), _col(0), _steps(0), _finalOnly(false), _detectCycle(false) {}
+    static constexpr int TILE = 64;
+
+    GameOfLife() : _row(0), _col(0), _steps(0), _finalOnly(false), _detectCycle(false),
+                   _tileRows(0), _tileCols(0), _changedTiles(0), _hash(0), _nextHash(0) {}
 
     void initBoard(int row, int col, int steps, bool finalOnly, bool detectCycle)
     {
@@ -131,40 +144,58 @@ public:
         for (size_t i = 0; i < _cell.size(); i++) {
             _cell[i] = (distrib(gen) == 1);
         }
+        resetTiles();
 
         if (_detectCycle) {
             _history.reserve(std::min(10000, _steps + 100));
         }
     }
 
-    void step()
+    // Replace the board after initBoard(), cell (i, j) is alive iff cells[i*col+j]
+    void loadCells(const uint8_t *cells)
     {
-        // Neighbor offsets for 8 directions
-        static const int dx[] = {-1, 0, 1, -1, 1, -1, 0, 1};
-        static const int dy[] = {-1, -1, -1, 0, 0, 1, 1, 1};
+        for (size_t i = 0; i < _cell.size(); i++) {
+            _cell[i] = cells[i] != 0;
+        }
+        resetTiles();
+    }
 
-        for (int i = 0; i < _row; i++) {
-            for (int j = 0; j < _col; j++) {
-                int count = 0;
-                
-                // Count live neighbors
-                for (int d = 0; d < 8; d++) {
-                    int ni = i + dx[d];
-                    int nj = j + dy[d];
+    // Live cells on the board
+    long population() const
+    {
+        return static_cast<long>(std::count(_cell.begin(), _cell.end(), true));
+    }
 
-                    // Toroidal wrapping
-                    if (ni < 0) ni += _row;
-                    else if (ni >= _row) ni -= _row;
+    // Advance several generations with nothing observed in between
+    void advance(int generations)
+    {
+        for (int i = 0; i < generations; i++) {
+            step();
+            update();
+        }
+    }
 
-                    if (nj < 0) nj += _col;
-                    else if (nj >= _col) nj -= _col;
-                    
-                    count += _cell[ni * _col + nj] ? 1 : 0;
+    void step()
+    {
+        markActiveTiles();
+        _nextHash = _hash;
+
+        for (int tr = 0; tr < _tileRows; tr++) {
+            for (int tc = 0; tc < _tileCols; tc++) {
+                const int t = tileIndex(tr, tc);
+                if (!_active[t]) {
+                    _nextChanged[t] = 0;
+                    continue;
+                }
+
+                bool alive = false;
+                uint64_t hash = 0;
+                _nextChanged[t] = stepTile(t, alive, hash);
+                _tileAlive[t] = alive;
+                if (_detectCycle && _nextChanged[t]) {
+                    _nextHash ^= _tileHash[t] ^ hash;
+                    _tileHash[t] = hash;
                 }
-                
-                // Game of Life rules
-                int idx = i * _col + j;
-                _nextCycle[idx] = (count == 3) || (_cell[idx] && count == 2);
             }
         }
     }
@@ -188,7 +219,6 @@ public:
             display();
         }
 
-        bool boardEmpty = false;
         bool boardStatic = false;
 
         for (int i = 0; i < _steps; i++) {
@@ -202,13 +232,11 @@ public:
                 _history.insert(hash);
             }
 
-            size_t prevHash = hashState();
             step();
             update();
-            size_t currHash = hashState();
 
-            // Check for static board
-            if (!_detectCycle && prevHash == currHash) {
+            // Check for static board, no tile changed in this generation
+            if (!_detectCycle && _changedTiles == 0) {
                 if (!boardStatic) {
                     std::cout << "Board became static at step " << (i + 1) << ". Stopping." << std::endl;
                     boardStatic = true;
@@ -221,9 +249,8 @@ public:
             }
 
             // Check for empty board
-            if (currHash == 0 || isEmptyBoard()) {
+            if (isEmptyBoard()) {
                 std::cout << "Board became empty at step " << (i + 1) << ". Stopping." << std::endl;
-                boardEmpty = true;
                 if (_finalOnly) {
                     std::cout << "Cycle: " << (i + 1) << std::endl;
                     display();
@@ -239,19 +266,142 @@ public:
     }
 
 private:
+    // Every tile starts dirty, the back buffer holds nothing yet
+    void resetTiles()
+    {
+        _tileRows = (_row + TILE - 1) / TILE;
+        _tileCols = (_col + TILE - 1) / TILE;
+        const size_t tiles = static_cast<size_t>(_tileRows) * _tileCols;
+        _changed.assign(tiles, 1);
+        _nextChanged.assign(tiles, 0);
+        _active.assign(tiles, 0);
+        _tileAlive.assign(tiles, 0);
+        _tileHash.assign(tiles, 0);
+        _changedTiles = static_cast<int>(tiles);
+        for (int i = 0; i < _row; i++) {
+            for (int j = 0; j < _col; j++) {
+                if (_cell[i * _col + j]) _tileAlive[tileIndex(i / TILE, j / TILE)] = 1;
+            }
+        }
+
+        _hash = 0x243f6a8885a308d3ull;
+        hash_combine(_hash, (uint64_t)_row);
+        hash_combine(_hash, (uint64_t)_col);
+        for (size_t t = 0; _detectCycle && t < tiles; t++) {
+            _tileHash[t] = hashTile(static_cast<int>(t));
+            _hash ^= _tileHash[t];
+        }
+    }
+
     void update()
     {
         _cell.swap(_nextCycle);
+        _changed.swap(_nextChanged);
+        _hash = _nextHash;
+        _changedTiles = static_cast<int>(std::count(_changed.begin(), _changed.end(), 1));
     }
 
     bool isEmptyBoard() const
     {
-        for (bool cell : _cell) {
-            if (cell) return false;
+        for (uint8_t alive : _tileAlive) {
+            if (alive) return false;
         }
         return true;
     }
 
+    // Steps one tile, returns whether any of its cells changed.
+    // With --detect-cycle, hash receives the tile hash of the new cells.
+    bool stepTile(int t, bool &alive, uint64_t &hash)
+    {
+        // Neighbor offsets for 8 directions
+        static const int dx[] = {-1, 0, 1, -1, 1, -1, 0, 1};
+        static const int dy[] = {-1, -1, -1, 0, 0, 1, 1, 1};
+
+        const int rowBegin = (t / _tileCols) * TILE;
+        const int colBegin = (t % _tileCols) * TILE;
+        const int rowEnd = std::min(rowBegin + TILE, _row);
+        const int colEnd = std::min(colBegin + TILE, _col);
+        bool changed = false;
+        alive = false;
+        const bool hashing = _detectCycle;
+        if (hashing) hash = splitmix64(static_cast<uint64_t>(t));
+
+        for (int i = rowBegin; i < rowEnd; i++) {
+            uint64_t word = 0;
+            for (int j = colBegin; j < colEnd; j++) {
+                int count = 0;
+
+                // Count live neighbors
+                for (int d = 0; d < 8; d++) {
+                    int ni = i + dx[d];
+                    int nj = j + dy[d];
+
+                    // Toroidal wrapping
+                    if (ni < 0) ni += _row;
+                    else if (ni >= _row) ni -= _row;
+
+                    if (nj < 0) nj += _col;
+                    else if (nj >= _col) nj -= _col;
+
+                    count += _cell[ni * _col + nj] ? 1 : 0;
+                }
+
+                // Game of Life rules
+                int idx = i * _col + j;
+                bool next = (count == 3) || (_cell[idx] && count == 2);
+                _nextCycle[idx] = next;
+                changed |= (next != _cell[idx]);
+                alive |= next;
+                if (hashing && next) word |= (uint64_t)1 << (j - colBegin);
+            }
+            if (hashing) hash_combine(hash, word);
+        }
+        return changed;
+    }
+
+    // Tile hash of the current cells, a TILE-wide tile row fits one word
+    uint64_t hashTile(int t) const
+    {
+        const int rowBegin = (t / _tileCols) * TILE;
+        const int colBegin = (t % _tileCols) * TILE;
+        const int rowEnd = std::min(rowBegin + TILE, _row);
+        const int colEnd = std::min(colBegin + TILE, _col);
+
+        uint64_t h = splitmix64(static_cast<uint64_t>(t));
+        for (int i = rowBegin; i < rowEnd; i++) {
+            uint64_t word = 0;
+            for (int j = colBegin; j < colEnd; j++) {
+                if (_cell[i * _col + j]) word |= (uint64_t)1 << (j - colBegin);
+            }
+            hash_combine(h, word);
+        }
+        return h;
+    }
+
+    // A tile is active when it or one of its 8 neighbours changed last generation
+    void markActiveTiles()
+    {
+        for (int tr = 0; tr < _tileRows; tr++) {
+            for (int tc = 0; tc < _tileCols; tc++) {
+                bool active = false;
+                for (int di = -1; di <= 1 && !active; di++) {
+                    for (int dj = -1; dj <= 1 && !active; dj++) {
+                        const int r = (tr + di + _tileRows) % _tileRows;
+                        const int c = (tc + dj + _tileCols) % _tileCols;
+                        active = _changed[tileIndex(r, c)] != 0;
+                    }
+                }
+                _active[tileIndex(tr, tc)] = active;
+            }
+        }
+    }
+
+    int tileIndex(int tr, int tc) const
+    {
+        return tr * _tileCols + tc;
+    }
+
+
     static inline uint64_t splitmix64(uint64_t x)
     {
         x += 0x9e3779b97f4a7c15ull;
@@ -268,24 +418,7 @@ private:
 
     size_t hashState() const
     {
-        uint64_t h = 0x243f6a8885a308d3ull;
-        hash_combine(h, (uint64_t)_row);
-        hash_combine(h, (uint64_t)_col);
-
-        uint64_t word = 0;
-        int bitpos = 0;
-
-        for (size_t i = 0; i < _cell.size(); ++i) {
-            if (_cell[i]) word |= (uint64_t)1 << bitpos;
-            ++bitpos;
-            if (bitpos == 64) {
-                hash_combine(h, word);
-                word = 0;
-                bitpos = 0;
-            }
-        }
-        if (bitpos) hash_combine(h, word);
-        return (size_t)h;
+        return (size_t)_hash;
     }
 
     int _row;
@@ -296,9 +429,23 @@ private:
 
     std::vector<bool> _cell;
     std::vector<bool> _nextCycle;
+
+    // Per-tile state, row-major over the tile grid
+    int _tileRows;
+    int _tileCols;
+    int _changedTiles;
+    std::vector<uint8_t> _changed;      // tile changed in the last generation
+    std::vector<uint8_t> _nextChanged;  // tile changed in the step being computed
+    std::vector<uint8_t> _active;       // tile must be stepped this generation
+    std::vector<uint8_t> _tileAlive;    // tile has a live cell
+    std::vector<uint64_t> _tileHash;    // hash of the tile's cells in the newest generation
+
+    uint64_t _hash;      // board hash of _cell
+    uint64_t _nextHash;  // board hash of _nextCycle
     std::unordered_set<size_t> _history;
 };
 
+#ifndef GOL_BENCH
 int main(int argc, char *argv[])
 {
     Option option;
@@ -319,3 +466,4 @@ int main(int argc, char *argv[])
 
     return 0;
 }
+#endif
@@ -0,0 +1,211 @@
+/*****************************************************************************
+
+    CUDA stencil for gol.cpp's cuda engine, see gol_cuda.h.
+
+    One thread computes one 64-cell word with the same bit-sliced adder as
+    PackedLife. A block of TILE_X x TILE_Y words first stages its tile and a
+    one-word halo in shared memory, so each board word is read from global
+    memory about once per generation instead of nine times.
+
+*****************************************************************************/
+
+#include "gol_cuda.h"
+
+#include <cuda_runtime.h>
+
+namespace {
+
+const int TILE_X = 32;      // words per block row, one warp
+const int TILE_Y = 8;
+
+struct Board {
+    int rows;
+    int cols;
+    int words;
+    uint64_t lastMask;
+    uint64_t *cell;         // front buffer
+    uint64_t *next;         // back buffer
+};
+
+const char *lastError = "";
+
+bool check(cudaError_t status)
+{
+    if (status != cudaSuccess)
+    {
+        lastError = cudaGetErrorString(status);
+        return false;
+    }
+    return true;
+}
+
+__device__ __forceinline__ void add3(uint64_t a, uint64_t b, uint64_t c, uint64_t &sum, uint64_t &carry)
+{
+    const uint64_t u = a ^ b;
+    sum = u ^ c;
+    carry = (a & b) | (u & c);
+}
+
+// lanes whose neighbour count is n, from the count planes b0..b3
+__device__ __forceinline__ uint64_t countIs(int n, uint64_t b0, uint64_t b1, uint64_t b2, uint64_t b3)
+{
+    if (n == 8)
+    {
+        return b3;
+    }
+    return ((n & 1) ? b0 : ~b0) & ((n & 2) ? b1 : ~b1) & ((n & 4) ? b2 : ~b2) & ~b3;
+}
+
+// neighbour words of one row: bit j of west is column j-1, of east column j+1
+__device__ __forceinline__ void shifted(uint64_t left, uint64_t mid, uint64_t right, int k, int words, int cols,
+                                        uint64_t &west, uint64_t &east)
+{
+    const int top = (cols - 1) & 63;
+    west = (mid << 1) | ((k == 0 ? left >> top : left >> 63) & 1);
+    east = (mid >> 1) | (k == words - 1 ? (right & 1) << top : right << 63);
+}
+
+__global__ void stepKernel(const uint64_t *cell, uint64_t *next, int rows, int cols, int words,
+                           uint64_t lastMask, int begin, int end, uint16_t birth, uint16_t survive)
+{
+    __shared__ uint64_t tile[TILE_Y + 2][TILE_X + 2];
+
+    const int x0 = blockIdx.x * TILE_X, y0 = begin + blockIdx.y * TILE_Y;
+
+    // tile plus halo, wrapped around the torus
+    for (int t = threadIdx.y * TILE_X + threadIdx.x; t < (TILE_Y + 2) * (TILE_X + 2); t += TILE_X * TILE_Y)
+    {
+        const int ly = t / (TILE_X + 2), lx = t % (TILE_X + 2);
+        const int gy = ((y0 + ly - 1) % rows + rows) % rows;
+        const int gx = ((x0 + lx - 1) % words + words) % words;
+        tile[ly][lx] = cell[static_cast<size_t>(gy) * words + gx];
+    }
+    __syncthreads();
+
+    const int k = x0 + threadIdx.x, i = y0 + threadIdx.y;
+    if (k >= words || i >= end)
+    {
+        return;
+    }
+
+    const int lx = threadIdx.x + 1, ly = threadIdx.y + 1;
+    uint64_t uw, ue, mw, me, dw, de;
+    shifted(tile[ly - 1][lx - 1], tile[ly - 1][lx], tile[ly - 1][lx + 1], k, words, cols, uw, ue);
+    shifted(tile[ly][lx - 1], tile[ly][lx], tile[ly][lx + 1], k, words, cols, mw, me);
+    shifted(tile[ly + 1][lx - 1], tile[ly + 1][lx], tile[ly + 1][lx + 1], k, words, cols, dw, de);
+    const uint64_t up = tile[ly - 1][lx], mid = tile[ly][lx], down = tile[ly + 1][lx];
+
+    uint64_t s_u, c_u, s_d, c_d, s0, c1;
+    add3(uw, up, ue, s_u, c_u);
+    add3(dw, down, de, s_d, c_d);
+    const uint64_t s_m = mw ^ me, c_m = mw & me;
+    add3(s_u, s_d, s_m, s0, c1);
+
+    uint64_t out;
+    if (birth == (1u << 3) && survive == ((1u << 2) | (1u << 3)))
+    {
+        // B3/S23: count is 2 or 3 iff exactly one weight-2 carry is set
+        uint64_t p, q;
+        add3(c_u, c_d, c_m, p, q);
+        out = ((p ^ c1) & ~q) & (s0 | mid);
+    }
+    else
+    {
+        uint64_t t0, t1;
+        add3(c_u, c_d, c_m, t0, t1);
+        const uint64_t b1 = t0 ^ c1, carry = t0 & c1;
+        const uint64_t b2 = t1 ^ carry, b3 = t1 & carry;
+
+        out = 0;
+        for (int n = 0; n <= 8; n++)
+        {
+            const uint64_t take = (((birth >> n) & 1) ? ~mid : 0) | (((survive >> n) & 1) ? mid : 0);
+            out |= countIs(n, s0, b1, b2, b3) & take;
+        }
+    }
+
+    if (k == words - 1)
+    {
+        out &= lastMask;
+    }
+    next[static_cast<size_t>(i) * words + k] = out;
+}
+
+} // namespace
+
+extern "C" {
+
+void *cudaBoardCreate(int rows, int cols)
+{
+    Board *b = new Board;
+    b->rows = rows;
+    b->cols = cols;
+    b->words = (cols + 63) / 64;
+    b->lastMask = (cols % 64) ? ((1ull << (cols % 64)) - 1) : ~0ull;
+    b->cell = nullptr;
+    b->next = nullptr;
+
+    const size_t bytes = static_cast<size_t>(rows) * b->words * sizeof(uint64_t);
+    if (!check(cudaMalloc(&b->cell, bytes)) || !check(cudaMalloc(&b->next, bytes))
+        || !check(cudaMemset(b->cell, 0, bytes)) || !check(cudaMemset(b->next, 0, bytes)))
+    {
+        cudaBoardDestroy(b);
+        return nullptr;
+    }
+    return b;
+}
+
+void cudaBoardDestroy(void *board)
+{
+    Board *b = static_cast<Board*>(board);
+    if (b)
+    {
+        cudaFree(b->cell);
+        cudaFree(b->next);
+        delete b;
+    }
+}
+
+bool cudaBoardUpload(void *board, const uint64_t *words)
+{
+    const Board *b = static_cast<const Board*>(board);
+    return check(cudaMemcpy(b->cell, words, static_cast<size_t>(b->rows) * b->words * sizeof(uint64_t),
+                            cudaMemcpyHostToDevice));
+}
+
+bool cudaBoardDownload(void *board, uint64_t *words)
+{
+    const Board *b = static_cast<const Board*>(board);
+    return check(cudaMemcpy(words, b->cell, static_cast<size_t>(b->rows) * b->words * sizeof(uint64_t),
+                            cudaMemcpyDeviceToHost));
+}
+
+bool cudaBoardStep(void *board, int begin, int end, uint16_t birth, uint16_t survive)
+{
+    const Board *b = static_cast<const Board*>(board);
+    if (end <= begin)
+    {
+        return true;
+    }
+
+    const dim3 block(TILE_X, TILE_Y);
+    const dim3 grid((b->words + TILE_X - 1) / TILE_X, (end - begin + TILE_Y - 1) / TILE_Y);
+    stepKernel<<<grid, block>>>(b->cell, b->next, b->rows, b->cols, b->words, b->lastMask,
+                                begin, end, birth, survive);
+    return check(cudaGetLastError());
+}
+
+void cudaBoardSwap(void *board)
+{
+    Board *b = static_cast<Board*>(board);
+    uint64_t *temp = b->cell;
+    b->cell = b->next;
+    b->next = temp;
+}
+
+const char *cudaBoardError()
+{
+    return lastError;
+}
+
+}
@@ -0,0 +1,35 @@
+/*
+    Device side of gol.cpp's cuda engine, implemented in gol_cuda.cu and
+    linked in with make CUDA=1.
+
+    A board is the PackedLife layout: rows of words uint64s, bit j of word
+    k is column 64k+j and the unused bits of the last word stay zero. Both
+    generations live in device memory; step() writes the back buffer and
+    swap() makes it the front one. Calls return false on a CUDA error,
+    cudaBoardError() has the message.
+*/
+#ifndef GOL_CUDA_H
+#define GOL_CUDA_H
+
+#include <cstdint>
+
+extern "C" {
+
+// nullptr when the device cannot hold two rows x cols boards
+void *cudaBoardCreate(int rows, int cols);
+void cudaBoardDestroy(void *board);
+
+// whole front buffer from / to host memory
+bool cudaBoardUpload(void *board, const uint64_t *words);
+bool cudaBoardDownload(void *board, uint64_t *words);
+
+// rows [begin, end) of the next generation into the back buffer; birth and
+// survive have bit n set for the neighbour counts n the rule keeps alive
+bool cudaBoardStep(void *board, int begin, int end, uint16_t birth, uint16_t survive);
+void cudaBoardSwap(void *board);
+
+const char *cudaBoardError();
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*
+    Phase timers and counters behind --stats.
+
+    Compiled in with -DWITH_STATS (make STATS=1). Without it every STATS_
+    macro expands to nothing, so release builds pay nothing. Phases are
+    summed over threads, counters are plain totals, gauges keep the last
+    value set. writeJson() adds <counter>_per_sec over the wall time since
+    start.
+*/
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace stats {
+
+class Registry
+{
+public :
+    static Registry &instance()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    void addTime(const char *phase, uint64_t ns)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Phase &p = _phases[phase];
+        p.ns += ns;
+        p.calls++;
+    }
+
+    void add(const char *counter, double value)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _counters[counter] += value;
+    }
+
+    void set(const char *gauge, double value)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _gauges[gauge] = value;
+    }
+
+    void writeJson(std::ostream &os)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+        os << "{\"wall_seconds\":" << wall << ",\"phases\":{";
+        const char *sep = "";
+        for (auto &p : _phases)
+        {
+            os << sep << "\"" << p.first << "\":{\"seconds\":" << p.second.ns * 1e-9
+               << ",\"calls\":" << p.second.calls << "}";
+            sep = ",";
+        }
+
+        os << "},\"counters\":{";
+        sep = "";
+        for (auto &c : _counters)
+        {
+            os << sep << "\"" << c.first << "\":" << static_cast<uint64_t>(c.second)
+               << ",\"" << c.first << "_per_sec\":" << (wall > 0 ? c.second / wall : 0);
+            sep = ",";
+        }
+
+        os << "},\"gauges\":{";
+        sep = "";
+        for (auto &g : _gauges)
+        {
+            os << sep << "\"" << g.first << "\":" << g.second;
+            sep = ",";
+        }
+        os << "}}" << std::endl;
+    }
+
+private :
+    struct Phase {
+        uint64_t ns = 0;
+        uint64_t calls = 0;
+    };
+
+    Registry() :
+        _start(std::chrono::steady_clock::now())
+    {
+    }
+
+    std::chrono::steady_clock::time_point _start;
+    std::mutex _mutex;
+    std::map<std::string, Phase> _phases;
+    std::map<std::string, double> _counters;
+    std::map<std::string, double> _gauges;
+};
+
+/* adds the lifetime of the scope to a phase */
+class ScopedTimer
+{
+public :
+    explicit ScopedTimer(const char *phase) :
+        _phase(phase),
+        _start(std::chrono::steady_clock::now())
+    {
+        // the wall clock starts no later than the first phase
+        Registry::instance();
+    }
+
+    ~ScopedTimer()
+    {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start);
+        Registry::instance().addTime(_phase, static_cast<uint64_t>(ns.count()));
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer &operator=(const ScopedTimer&) = delete;
+
+private :
+    const char *_phase;
+    std::chrono::steady_clock::time_point _start;
+};
+
+} // namespace stats
+
+#define STATS_CONCAT_(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_(a, b)
+
+#ifdef WITH_STATS
+#define STATS_ENABLED true
+#define STATS_TIMER(phase) stats::ScopedTimer STATS_CONCAT(statsTimer, __LINE__)(phase)
+#define STATS_ADD(counter, value) stats::Registry::instance().add(counter, static_cast<double>(value))
+#define STATS_SET(gauge, value) stats::Registry::instance().set(gauge, static_cast<double>(value))
+#define STATS_JSON(os) stats::Registry::instance().writeJson(os)
+#else
+#define STATS_ENABLED false
+#define STATS_TIMER(phase) do {} while (0)
+#define STATS_ADD(counter, value) ((void)(value))
+#define STATS_SET(gauge, value) ((void)(value))
+#define STATS_JSON(os) ((void)(os))
+#endif
+
+#endif